@@ -1,18 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-// Structure for a binary tree node
-typedef struct Node 
-{
-    int data;
-    struct Node* left;
-    struct Node* right;
-} Node;
+#include "bstree.h"
 
 // Structure for a queue node
 typedef struct QueueNode 
 {
-    Node* treeNode;
+    BstNode* treeNode;
     struct QueueNode* next;
 } QueueNode;
 
@@ -24,11 +18,13 @@ typedef struct Queue
 } Queue;
 
 /**
- * Creates a new tree node.
- * @param data Value for the node.
- * @return Pointer to the created node.
+ * Adds a value to the tree starting from the last visited node.
+ * The tree holds bare values, so a value already in it is not added again.
+ * @param tree Pointer to the tree.
+ * @param finger Pointer to the finger; updated to the added (or existing) node.
+ * @param data Value to add.
  */
-Node* create(int data);
+void add(BstTree* tree, BstFinger* finger, int data);
 
 /**
  * Creates a new empty queue.
@@ -36,58 +32,26 @@ Node* create(int data);
  */
 Queue* createQueue();
 
-/**
- * Adds a node to the tree.
- * @param root The root node of the tree.
- * @param data Value to add.
- * @return Pointer to the root node.
- */
-Node* add(Node* root, int data);
-
 /**
  * Adds a tree node to the queue.
  * @param queue Pointer to the queue.
  * @param treeNode Pointer to the tree node to be added to the queue.
  */
-void enqueue(Queue* queue, Node* treeNode);
-
-/**
- * Searches for a node in the tree.
- * @param root The root node of the tree.
- * @param data The value to search for.
- * @param parent Pointer to the pointer of the parent node.
- * @return Pointer to the found node or NULL.
- */
-Node* search(Node* root, int data, Node** parent);
+void enqueue(Queue* queue, BstNode* treeNode);
 
 /**
  * Prints the binary tree in a visually structured format.
  * @param root Pointer to the root node of the tree.
  * @param level Current level of the node being printed.
  */
-void print(Node* root, int level);
+void print(BstNode* root, int level);
 
 /**
  * Prints information about the found node.
  * @param node Pointer to the found node.
  * @param parent Pointer to the parent node.
  */
-void printNodeInfo(Node* node, Node* parent);
-
-/**
- * Finds the minimum node in the tree.
- * @param node The node to start the search from.
- * @return Pointer to the minimum node.
- */
-Node* findMin(Node* node);
-
-/**
- * Removes a node from the tree.
- * @param root The root node of the tree.
- * @param data Value to delete.
- * @return Pointer to the root node.
- */
-Node* deleteNode(Node* root, int data);
+void printNodeInfo(BstNode* node, BstNode* parent);
 
 /**
  * Adds a tree node to the queue.
@@ -95,45 +59,46 @@ Node* deleteNode(Node* root, int data);
  * @param queue Pointer to the queue.
  * @param treeNode Pointer to the tree node to be added to the queue.
  */
-Node* dequeue(Queue* queue);
+BstNode* dequeue(Queue* queue);
 
 /**
  * Replaces a node with a specified key with a new node with a new key.
- * @param root Pointer to the root node of the tree.
+ * @param tree Pointer to the tree.
+ * @param finger Pointer to the finger; reset, as the old node is freed.
  * @param oldKey The key of the node to be replaced.
  * @param newKey The key of the new node.
  */
-void replace(Node** root, int oldKey, int newKey);
+void replace(BstTree* tree, BstFinger* finger, int oldKey, int newKey);
 
 /**
  * Performs pre-order tree traversal.
  * @param root The root node of the tree.
  */
-void preOrder(Node* root);
+void preOrder(BstNode* root);
 
 /**
  * Performs symmetric (in-order) traversal of the tree.
  * @param root The root node of the tree.
  */
-void inOrder(Node* root);
+void inOrder(BstNode* root);
 
 /**
  * Performs a reverse (post-order) traversal of the tree.
  * @param root The root node of the tree.
  */
-void postOrder(Node* root);
+void postOrder(BstNode* root);
 
 /**
  * Performs a level-order traversal of the tree.
  * @param root The root node of the tree.
  */
-void levelOrder(Node* root);
+void levelOrder(BstNode* root);
 
 /**
  * Counts the number of nodes at each level of the tree.
  * @param root The root node of the tree.
  */
-void countNodesAtEachLevel(Node* root);
+void countNodesAtEachLevel(BstNode* root);
 
 /**
  * Frees all nodes in the queue and the queue itself.
@@ -143,13 +108,17 @@ void freeQueue(Queue* queue);
 
 int main() 
 {
-    // Initializing the root of the tree
-    Node* root = NULL;
+    // Initializing the tree
+    BstTree tree;
+    bstInit(&tree);
 
     int choice, value, oldkey, newkey;
 
     // Initializing the parent node
-    Node* parent = NULL;
+    BstNode* parent = NULL;
+
+    // Last visited node, used as the starting point of the next add/search
+    BstFinger finger = { NULL };
 
     while (1) 
 	{
@@ -169,42 +138,46 @@ int main()
             case 1:
                 printf("Enter value to add: ");
                 scanf("%d", &value);
-                root = add(root, value);
+                add(&tree, &finger, value);
                 break;
             case 2:
                 printf("Enter value to search: ");
                 scanf("%d", &value);
-                Node* node = search(root, value, &parent);
+                BstNode* node = bstFingerFind(&tree, &finger, value);
+                parent = node ? node->parent : NULL;
                 printNodeInfo(node, parent);
                 break;
             case 3:
                 printf("Enter value to delete: ");
                 scanf("%d", &value);
-                root = deleteNode(root, value);
+                bstRemoveKey(&tree, value);
+                // The finger may point to a freed node, restart from the root
+                finger.node = NULL;
                 break;
             case 4:
                 printf("Enter oldkey: \n");
                 scanf("%d", &oldkey);
                 printf("Enter newkey: \n");
                 scanf("%d", &newkey);
-                replace(&root, oldkey, newkey);
+                replace(&tree, &finger, oldkey, newkey);
                 break;
             case 5:
-                print(root, 0);
+                print(tree.root, 0);
                 printf("Pre-order traversal: ");
-                preOrder(root);
+                preOrder(tree.root);
                 printf("\nIn-order traversal: ");
-                inOrder(root);
+                inOrder(tree.root);
                 printf("\nPost-order traversal: ");
-                postOrder(root);
+                postOrder(tree.root);
                 printf("\nLevel-order traversal: ");
-                levelOrder(root);
+                levelOrder(tree.root);
                 printf("\n");
                 break;
             case 6:
-                countNodesAtEachLevel(root);
+                countNodesAtEachLevel(tree.root);
                 break;
             case 7:
+                bstClear(&tree);
                 exit(0);
             default:
                 printf("Invalid choice. Please try again.\n");
@@ -213,25 +186,20 @@ int main()
     return 0;
 }
 
-
-Node* create(int data) 
+void add(BstTree* tree, BstFinger* finger, int data) 
 {
-    Node* newNode = (Node*)malloc(sizeof(Node));
-
-    if (newNode == NULL) 
+    if (bstFingerFind(tree, finger, data) != NULL) 
     {
-        // Checking for memory allocation error
-        printf("Memory allocation failed\n");
-        exit(1);
+        // The value is already in the tree
+        printf("Value %d already exists in the tree.\n", data);
+        return;
     }
-    
-    newNode->data = data;
-    newNode->left = NULL;
-    newNode->right = NULL;
-    
-    return newNode;
+
+    // The demo stores bare values, so the entries carry no payload
+    bstFingerInsert(tree, finger, data, NULL);
 }
 
+
 Queue* createQueue() 
 {
     Queue* queue = (Queue*)malloc(sizeof(Queue));
@@ -247,36 +215,7 @@ Queue* createQueue()
     return queue;
 }
 
-Node* add(Node* root, int data) 
-{
-    if (root == NULL) 
-	{
-        // If the tree is empty, create a new node
-        return create(data);
-    }
-
-    // Add a node to the left subtree
-    if (data < root->data) 
-	{
-        root->left = add(root->left, data);
-    } 
-    
-    // Add a node to the right subtree
-    else if (data > root->data) 
-	{
-        root->right = add(root->right, data);  
-    } 
-    
-    else 
-	{
-        // A node with this value already exists
-        printf("Value %d already exists in the tree.\n", data);
-    }
-
-    return root;
-}
-
-void enqueue(Queue* queue, Node* treeNode) 
+void enqueue(Queue* queue, BstNode* treeNode) 
 {
     QueueNode* newNode = (QueueNode*)malloc(sizeof(QueueNode));
 
@@ -304,32 +243,7 @@ void enqueue(Queue* queue, Node* treeNode)
 }
 
 
-Node* search(Node* root, int data, Node** parent) 
-{
-    Node* current = root;
-    *parent = NULL;
-
-    while (current != NULL && current->data != data) 
-	{
-        // Update the parent node
-        *parent = current;
-        
-        // Move left or right depending on the value
-        if (data < current->data) 
-		{
-            current = current->left;
-        } 
-        
-        else 
-		{
-            current = current->right;
-        }
-    }
-
-    return current;
-}
-
-void print(Node* root, int level) 
+void print(BstNode* root, int level) 
 {
     if (root != NULL) 
     {
@@ -337,14 +251,14 @@ void print(Node* root, int level)
         print(root->right, level + 1);
 
         // Print the current node with indentation based on its level
-        printf("%*s%d\n", 4 * level, "", root->data);
+        printf("%*s%d\n", 4 * level, "", root->key);
 
         // Print the left subtree
         print(root->left, level + 1);
     }
 }
 
-void printNodeInfo(Node* node, Node* parent) 
+void printNodeInfo(BstNode* node, BstNode* parent) 
 {
     if (node == NULL) 
     {
@@ -352,85 +266,33 @@ void printNodeInfo(Node* node, Node* parent)
         return;
     }
 
-    printf("Node - %d\n", node->data);
+    printf("Node - %d\n", node->key);
 
     if (parent)
-        printf("Parent - %d\n", parent->data);
+        printf("Parent - %d\n", parent->key);
     else
         printf("Parent - NULL\n");
 
     if (node->left)
-        printf("Left child - %d\n", node->left->data);
+        printf("Left child - %d\n", node->left->key);
     else
         printf("Left child - NULL\n");
 
     if (node->right)
-        printf("Right child - %d\n", node->right->data);
+        printf("Right child - %d\n", node->right->key);
     else
         printf("Right child - NULL\n");
 }
 
 
-Node* findMin(Node* node) 
-{
-    while (node->left != NULL) 
-	{
-        node = node->left;
-    }
-    
-    return node;
-}
-
-Node* deleteNode(Node* root, int data) 
-{
-    // Base case: If the tree is empty, return NULL
-    if (root == NULL) return root;
-
-    // Recursively find the node to be deleted
-    if (data < root->data) 
-	{
-        root->left = deleteNode(root->left, data);
-    } 
-    
-    else if (data > root->data) 
-	{
-        root->right = deleteNode(root->right, data);  
-    } 
-    
-    else 
-	{
-        // Node with the data found
-        if (root->left == NULL) 
-		{
-            Node* temp = root->right;
-            free(root);
-            return temp;
-        } 
-        
-        else if (root->right == NULL) 
-		{
-            Node* temp = root->left;
-            free(root);
-            return temp;
-        }
-
-        // Node with two children: get the inorder successor (smallest in the right subtree)
-        Node* temp = findMin(root->right);
-        root->data = temp->data;
-        root->right = deleteNode(root->right, temp->data);
-    }
-
-    return root;
-}
-
-Node* dequeue(Queue* queue) 
+BstNode* dequeue(Queue* queue) 
 {
     // If the queue is empty, return NULL
     if (queue->front == NULL) return NULL;
 
     // Remove the front node from the queue and update the front pointer
     QueueNode* temp = queue->front;
-    Node* treeNode = temp->treeNode;
+    BstNode* treeNode = temp->treeNode;
     queue->front = queue->front->next;
 
     // If the queue is empty now, update the rear pointer to NULL
@@ -440,49 +302,50 @@ Node* dequeue(Queue* queue)
     return treeNode;
 }
 
-void replace(Node** root, int oldKey, int newKey) 
+void replace(BstTree* tree, BstFinger* finger, int oldKey, int newKey) 
 {
     // Delete the node with oldKey
-    *root = deleteNode(*root, oldKey);
+    bstRemoveKey(tree, oldKey);
+    finger->node = NULL;
 
     // Add a new node with newKey
-    *root = add(*root, newKey);
+    add(tree, finger, newKey);
 }
 
-void preOrder(Node* root) 
+void preOrder(BstNode* root) 
 {
     // Traverse the tree in pre-order: visit root, then left subtree, then right subtree
     if (root != NULL) 
 	{
-        printf("%d ", root->data);
+        printf("%d ", root->key);
         preOrder(root->left);
         preOrder(root->right);
     }
 }
 
-void inOrder(Node* root) 
+void inOrder(BstNode* root) 
 {
     // Traverse the tree in in-order: visit left subtree, then root, then right subtree
     if (root != NULL) 
 	{
         inOrder(root->left);
-        printf("%d ", root->data);
+        printf("%d ", root->key);
         inOrder(root->right);
     }
 }
 
-void postOrder(Node* root) 
+void postOrder(BstNode* root) 
 {
     // Traverse the tree in post-order: visit left subtree, then right subtree, then root
     if (root != NULL) 
 	{
         postOrder(root->left);
         postOrder(root->right);
-        printf("%d ", root->data);
+        printf("%d ", root->key);
     }
 }
 
-void levelOrder(Node* root) 
+void levelOrder(BstNode* root) 
 {
     // Perform level-order traversal using a queue
     if (root == NULL) return;
@@ -492,8 +355,8 @@ void levelOrder(Node* root)
 
     while (queue->front != NULL) 
     {
-        Node* current = dequeue(queue);
-        printf("%d ", current->data);
+        BstNode* current = dequeue(queue);
+        printf("%d ", current->key);
 
         if (current->left != NULL) enqueue(queue, current->left);
         if (current->right != NULL) enqueue(queue, current->right);
@@ -503,7 +366,7 @@ void levelOrder(Node* root)
 }
 
 
-void countNodesAtEachLevel(Node* root) 
+void countNodesAtEachLevel(BstNode* root) 
 {
     // Count and print the number of nodes at each level of the tree
     if (root == NULL) return;
@@ -519,7 +382,7 @@ void countNodesAtEachLevel(Node* root)
 
         while (queue->front != NULL) 
         {
-            Node* current = dequeue(queue);
+            BstNode* current = dequeue(queue);
             nodeCount++;
 
             if (current->left != NULL) enqueue(levelQueue, current->left);
@@ -0,0 +1,441 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bstree.h"
+
+/**
+ * Creates a new tree node without entries.
+ * @param key Key of the node.
+ * @param parent Parent of the node, or NULL for the root.
+ * @return Pointer to the created node.
+ */
+static BstNode* createNode(int key, BstNode* parent)
+{
+    BstNode* newNode = (BstNode*)malloc(sizeof(BstNode));
+
+    if (newNode == NULL)
+    {
+        // Checking for memory allocation error
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+
+    newNode->key = key;
+    newNode->left = NULL;
+    newNode->right = NULL;
+    newNode->parent = parent;
+    newNode->first = NULL;
+    newNode->last = NULL;
+    newNode->count = 0;
+
+    return newNode;
+}
+
+/**
+ * Finds the node with the smallest key in a subtree.
+ * @param node The root of the subtree.
+ * @return Pointer to the minimum node.
+ */
+static BstNode* findMin(BstNode* node)
+{
+    while (node->left != NULL)
+    {
+        node = node->left;
+    }
+
+    return node;
+}
+
+/**
+ * Finds the node with the largest key in a subtree.
+ * @param node The root of the subtree.
+ * @return Pointer to the maximum node.
+ */
+static BstNode* findMax(BstNode* node)
+{
+    while (node->right != NULL)
+    {
+        node = node->right;
+    }
+
+    return node;
+}
+
+/**
+ * Puts a subtree in the place of a node below the node's parent.
+ * @param tree Pointer to the tree.
+ * @param node The node being replaced.
+ * @param child The subtree taking its place, or NULL.
+ */
+static void transplant(BstTree* tree, BstNode* node, BstNode* child)
+{
+    if (node->parent == NULL)
+    {
+        tree->root = child;
+    }
+
+    else if (node == node->parent->left)
+    {
+        node->parent->left = child;
+    }
+
+    else
+    {
+        node->parent->right = child;
+    }
+
+    if (child) child->parent = node->parent;
+}
+
+/**
+ * Unlinks a node from the tree and frees it.
+ * A node with two children is replaced by its in-order successor itself rather
+ * than by a copy of its key, so the entries keep pointing at their own nodes.
+ * @param tree Pointer to the tree.
+ * @param node The node to remove.
+ */
+static void deleteNode(BstTree* tree, BstNode* node)
+{
+    if (node->left == NULL)
+    {
+        transplant(tree, node, node->right);
+    }
+
+    else if (node->right == NULL)
+    {
+        transplant(tree, node, node->left);
+    }
+
+    else
+    {
+        // Node with two children: the smallest node in the right subtree takes its place
+        BstNode* next = findMin(node->right);
+
+        if (next->parent != node)
+        {
+            transplant(tree, next, next->right);
+            next->right = node->right;
+            next->right->parent = next;
+        }
+
+        transplant(tree, node, next);
+        next->left = node->left;
+        next->left->parent = next;
+    }
+
+    tree->keys--;
+    free(node);
+}
+
+void bstInit(BstTree* tree)
+{
+    tree->root = NULL;
+    tree->size = 0;
+    tree->keys = 0;
+}
+
+/**
+ * Climbs from the finger until the key lies inside the current subtree.
+ * The first ancestor entered from the left bounds the subtree from above,
+ * the first one entered from the right bounds it from below.
+ * @param tree Pointer to the tree.
+ * @param finger Pointer to the finger.
+ * @param key The key to locate.
+ * @return Node to descend from (the node itself if it holds the key).
+ */
+static BstNode* fingerClimb(const BstTree* tree, const BstFinger* finger, int key)
+{
+    BstNode* top = finger->node ? finger->node : tree->root;
+    BstNode* current = top;
+    int lowerOk = 0, upperOk = 0;
+
+    while (current != NULL && current->parent != NULL && !(lowerOk && upperOk))
+    {
+        BstNode* parent = current->parent;
+
+        if (parent->key == key) return parent;
+
+        if (current == parent->left)
+        {
+            // Everything below parent->left is smaller than parent->key
+            if (key > parent->key)
+            {
+                top = parent;
+                lowerOk = upperOk = 0;
+            }
+            else
+            {
+                upperOk = 1;
+            }
+        }
+
+        else
+        {
+            // Everything below parent->right is greater than parent->key
+            if (key < parent->key)
+            {
+                top = parent;
+                lowerOk = upperOk = 0;
+            }
+            else
+            {
+                lowerOk = 1;
+            }
+        }
+
+        current = parent;
+    }
+
+    return top;
+}
+
+BstEntry* bstInsert(BstTree* tree, int key, void* payload)
+{
+    // Without a finger the climb starts and ends at the root
+    BstFinger finger = { NULL };
+    return bstFingerInsert(tree, &finger, key, payload);
+}
+
+BstEntry* bstFingerInsert(BstTree* tree, BstFinger* finger, int key, void* payload)
+{
+    BstEntry* entry = (BstEntry*)malloc(sizeof(BstEntry));
+
+    if (entry == NULL)
+    {
+        // Checking for memory allocation error
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+
+    BstNode* node = fingerClimb(tree, finger, key);
+
+    if (node == NULL)
+    {
+        // The tree is empty
+        node = tree->root = createNode(key, NULL);
+        tree->keys++;
+    }
+
+    // Move left or right depending on the key until it is found or a leaf is reached
+    while (node->key != key)
+    {
+        BstNode** link = key < node->key ? &node->left : &node->right;
+
+        if (*link == NULL)
+        {
+            // Attach the new leaf below the last visited node
+            *link = createNode(key, node);
+            tree->keys++;
+        }
+
+        node = *link;
+    }
+
+    // Append the entry to the entries of the key
+    finger->node = node;
+    entry->payload = payload;
+    entry->node = node;
+    entry->next = NULL;
+    entry->prev = node->last;
+
+    if (node->last) node->last->next = entry;
+    else node->first = entry;
+
+    node->last = entry;
+    node->count++;
+    tree->size++;
+
+    return entry;
+}
+
+void bstRemove(BstTree* tree, BstEntry* entry)
+{
+    BstNode* node = entry->node;
+
+    if (entry->prev) entry->prev->next = entry->next;
+    else node->first = entry->next;
+
+    if (entry->next) entry->next->prev = entry->prev;
+    else node->last = entry->prev;
+
+    node->count--;
+    tree->size--;
+    free(entry);
+
+    // The last entry of a key takes its node along
+    if (node->count == 0) deleteNode(tree, node);
+}
+
+size_t bstRemoveKey(BstTree* tree, int key)
+{
+    BstNode* node = bstFind(tree, key);
+    if (node == NULL) return 0;
+
+    size_t removed = node->count;
+
+    // The node goes with its last entry
+    for (size_t i = 0; i < removed; i++)
+    {
+        bstRemove(tree, node->first);
+    }
+
+    return removed;
+}
+
+BstNode* bstFind(const BstTree* tree, int key)
+{
+    BstNode* current = tree->root;
+
+    while (current != NULL && current->key != key)
+    {
+        current = key < current->key ? current->left : current->right;
+    }
+
+    return current;
+}
+
+BstNode* bstFingerFind(const BstTree* tree, BstFinger* finger, int key)
+{
+    BstNode* current = fingerClimb(tree, finger, key);
+    BstNode* last = current;
+
+    // Descend from the climbed-to node as in a regular search
+    while (current != NULL && current->key != key)
+    {
+        last = current;
+        current = key < current->key ? current->left : current->right;
+    }
+
+    finger->node = current ? current : last;
+    return current;
+}
+
+BstNode* bstCeil(const BstTree* tree, int key)
+{
+    BstNode* current = tree->root;
+    BstNode* found = NULL;
+
+    while (current != NULL)
+    {
+        if (current->key >= key)
+        {
+            // A candidate; a smaller one can only be on the left
+            found = current;
+            current = current->left;
+        }
+
+        else
+        {
+            current = current->right;
+        }
+    }
+
+    return found;
+}
+
+BstNode* bstFloor(const BstTree* tree, int key)
+{
+    BstNode* current = tree->root;
+    BstNode* found = NULL;
+
+    while (current != NULL)
+    {
+        if (current->key <= key)
+        {
+            // A candidate; a larger one can only be on the right
+            found = current;
+            current = current->right;
+        }
+
+        else
+        {
+            current = current->left;
+        }
+    }
+
+    return found;
+}
+
+BstNode* bstNext(const BstNode* node)
+{
+    if (node->right != NULL) return findMin(node->right);
+
+    // Climb until the node is in a left subtree
+    while (node->parent != NULL && node == node->parent->right)
+    {
+        node = node->parent;
+    }
+
+    return node->parent;
+}
+
+BstNode* bstPrev(const BstNode* node)
+{
+    if (node->left != NULL) return findMax(node->left);
+
+    // Climb until the node is in a right subtree
+    while (node->parent != NULL && node == node->parent->left)
+    {
+        node = node->parent;
+    }
+
+    return node->parent;
+}
+
+size_t bstVisitRange(const BstTree* tree, int low, int high, BstVisitor visit, void* context)
+{
+    size_t visited = 0;
+
+    for (BstNode* node = bstCeil(tree, low); node != NULL && node->key <= high; node = bstNext(node))
+    {
+        for (BstEntry* entry = node->first; entry != NULL; entry = entry->next)
+        {
+            visit(entry->payload, node->key, context);
+            visited++;
+        }
+    }
+
+    return visited;
+}
+
+void bstClear(BstTree* tree)
+{
+    BstNode* current = tree->root;
+
+    // Free the nodes bottom-up without recursion: descend to a leaf, free it and
+    // continue from its parent
+    while (current != NULL)
+    {
+        if (current->left != NULL)
+        {
+            current = current->left;
+            continue;
+        }
+
+        if (current->right != NULL)
+        {
+            current = current->right;
+            continue;
+        }
+
+        BstNode* parent = current->parent;
+        if (parent != NULL)
+        {
+            if (parent->left == current) parent->left = NULL;
+            else parent->right = NULL;
+        }
+
+        BstEntry* entry = current->first;
+        while (entry != NULL)
+        {
+            BstEntry* next = entry->next;
+            free(entry);
+            entry = next;
+        }
+
+        free(current);
+        current = parent;
+    }
+
+    bstInit(tree);
+}
@@ -0,0 +1,156 @@
+#ifndef BSTREE_H
+#define BSTREE_H
+
+#include <stddef.h>
+
+// Payload stored in the tree under a key; entries with equal keys are kept in
+// the order they were inserted
+typedef struct BstEntry
+{
+    void* payload;
+    struct BstNode* node;
+    struct BstEntry* prev;
+    struct BstEntry* next;
+} BstEntry;
+
+// Structure for a tree node, holding every entry with one key
+typedef struct BstNode
+{
+    int key;
+    struct BstNode* left;
+    struct BstNode* right;
+    struct BstNode* parent;
+
+    BstEntry* first;
+    BstEntry* last;
+    size_t count;
+} BstNode;
+
+// Binary search tree of payloads ordered by key. Duplicate keys share a node,
+// so the depth depends on the number of distinct keys, not on the entries
+typedef struct BstTree
+{
+    BstNode* root;
+    size_t size;
+    size_t keys;
+} BstTree;
+
+// Remembers the last visited node so the next operation can start near it;
+// it must be reset to NULL when nodes are removed
+typedef struct BstFinger
+{
+    BstNode* node;
+} BstFinger;
+
+// Receives the entries found in the tree
+typedef void (*BstVisitor)(void* payload, int key, void* context);
+
+/**
+ * Initializes an empty tree.
+ * @param tree Pointer to the tree.
+ */
+void bstInit(BstTree* tree);
+
+/**
+ * Adds a payload to the tree after every entry with the same key.
+ * @param tree Pointer to the tree.
+ * @param key The key.
+ * @param payload The payload to store.
+ * @return Pointer to the new entry, which stays valid until it is removed.
+ */
+BstEntry* bstInsert(BstTree* tree, int key, void* payload);
+
+/**
+ * Adds a payload to the tree starting from the last visited node.
+ * Climbs only until the key falls inside the current subtree, then descends,
+ * so keys close to the previous one are reached without going back to the root.
+ * @param tree Pointer to the tree.
+ * @param finger Pointer to the finger; updated to the node of the key.
+ * @param key The key.
+ * @param payload The payload to store.
+ * @return Pointer to the new entry, which stays valid until it is removed.
+ */
+BstEntry* bstFingerInsert(BstTree* tree, BstFinger* finger, int key, void* payload);
+
+/**
+ * Removes an entry from the tree and frees it.
+ * The node of its key goes with the last entry of the key.
+ * @param tree Pointer to the tree.
+ * @param entry The entry returned by bstInsert.
+ */
+void bstRemove(BstTree* tree, BstEntry* entry);
+
+/**
+ * Removes every entry with a key, and the node of the key.
+ * @param tree Pointer to the tree.
+ * @param key The key to delete.
+ * @return The number of entries removed.
+ */
+size_t bstRemoveKey(BstTree* tree, int key);
+
+/**
+ * Searches for the node of a key.
+ * @param tree Pointer to the tree.
+ * @param key The key to search for.
+ * @return Pointer to the found node or NULL.
+ */
+BstNode* bstFind(const BstTree* tree, int key);
+
+/**
+ * Searches for the node of a key starting from the last visited node instead of the root.
+ * @param tree Pointer to the tree.
+ * @param finger Pointer to the finger; updated to the last visited node.
+ * @param key The key to search for.
+ * @return Pointer to the found node or NULL.
+ */
+BstNode* bstFingerFind(const BstTree* tree, BstFinger* finger, int key);
+
+/**
+ * Finds the node with the smallest key not less than a given one.
+ * @param tree Pointer to the tree.
+ * @param key The lower bound.
+ * @return Pointer to the node, or NULL if every key is less.
+ */
+BstNode* bstCeil(const BstTree* tree, int key);
+
+/**
+ * Finds the node with the largest key not greater than a given one.
+ * @param tree Pointer to the tree.
+ * @param key The upper bound.
+ * @return Pointer to the node, or NULL if every key is greater.
+ */
+BstNode* bstFloor(const BstTree* tree, int key);
+
+/**
+ * Returns the in-order successor of a node, following the parent links.
+ * @param node The current node.
+ * @return Pointer to the node with the next larger key, or NULL.
+ */
+BstNode* bstNext(const BstNode* node);
+
+/**
+ * Returns the in-order predecessor of a node, following the parent links.
+ * @param node The current node.
+ * @return Pointer to the node with the next smaller key, or NULL.
+ */
+BstNode* bstPrev(const BstNode* node);
+
+/**
+ * Visits the entries with keys in an inclusive range in key order.
+ * Only the nodes inside the range are visited after one descent to its start.
+ * @param tree Pointer to the tree.
+ * @param low The smallest key.
+ * @param high The largest key.
+ * @param visit Called for every entry, in insertion order among equal keys.
+ * @param context Passed to the visitor.
+ * @return The number of entries visited.
+ */
+size_t bstVisitRange(const BstTree* tree, int low, int high, BstVisitor visit, void* context);
+
+/**
+ * Frees every node and entry, leaving the tree empty. Payloads are not touched.
+ * @param tree Pointer to the tree.
+ */
+void bstClear(BstTree* tree);
+
+#endif
@@ -1,6 +1,53 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <time.h>
+#include <errno.h>
+
+#include "../bst/bstree.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LIST_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LIST_POSIX 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// Define LIST_NO_THREADS to build without pthreads; parallel loading then runs serially
+#if defined(LIST_POSIX) && !defined(LIST_NO_THREADS)
+#define LIST_THREADS 1
+#include <pthread.h>
+#endif
+
+// The query server needs epoll, so it is only built on Linux
+#if defined(__linux__) && defined(LIST_THREADS)
+#define LIST_SERVER 1
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+// Start of the surname and name packed big-endian and zero padded, so that
+// comparing the words as integers orders students like comparing the strings;
+// the strings themselves are only needed when all the packed bytes agree
+typedef struct 
+{
+    uint64_t surname[2];
+    uint64_t name;
+    
+} StudKey;
 
 // Structure representing the student
 typedef struct Student 
@@ -11,21 +58,399 @@ typedef struct Student
     
     int age;
     int average_score;
+
+    // Position of the record in its pool block, which leads back to the block
+    uint32_t slot;
+
+    // Row of the student in the columnar copy of the list
+    uint32_t row;
+
+    // Sort key, kept next to the links used when walking the list
+    StudKey key;
     
     struct Student *next;
     struct Student *prev;
+
+    // Chain of students with the same surname in the surname index
+    struct Student *nextSame;
+    struct Student *prevSame;
+
+    // Node of the student in the ordered index
+    struct OrderNode *orderNode;
+
+    // Entry of the student in the score index
+    BstEntry *scoreEntry;
     
 } stud;
 
+// Slot of the surname index, holding the chain of students sharing one surname
+typedef struct 
+{
+    uint64_t hash;
+    stud *first;
+    stud *last;
+    size_t count;
+    
+} SurnameSlot;
+
+// Open-addressing hash table from surname to the chain of matching students
+typedef struct 
+{
+    SurnameSlot *slots;
+    size_t capacity;
+    size_t used;
+
+    // Set while a chain may not follow the list order: a student was inserted
+    // away from the others with its surname. The next sort rebuilds the chains
+    int stale;
+    
+} SurnameIndex;
+
+// Skip list node of the ordered index; next holds one link per level
+typedef struct OrderNode 
+{
+    stud *student;
+    struct OrderNode *prev;
+    int level;
+    struct OrderNode *next[];
+    
+} OrderNode;
+
+// Levels of the ordered index; a node reaches every next level with probability 1/4
+#define ORDER_MAX_LEVEL 24
+
+// Skip list holding all students by surname and name; equal keys keep the order
+// a stable sort of the list would give them
+typedef struct 
+{
+    OrderNode *head;
+    int level;
+    uint32_t seed;
+
+    // Last node on every level, so appending in order needs no search
+    OrderNode *last[ORDER_MAX_LEVEL];
+
+    // The list follows the index order, except for the displaced student if set
+    int sorted;
+    stud *displaced;
+    
+} OrderIndex;
+
+// Node of the surname trie; the edge from the parent is labelled with a run of
+// letters, and children are kept in letter order
+typedef struct TrieNode 
+{
+    struct TrieNode *child;
+    struct TrieNode *sibling;
+    char label[19];
+    unsigned char length;
+
+    // A surname of the list ends at this node
+    int terminal;
+    
+} TrieNode;
+
+// Receives the surnames found in the trie, in alphabetical order
+typedef void (*SurnameVisitor)(const char *surname, int distance, void *context);
+
+// Block of student records allocated in one piece
+typedef struct StudBlock 
+{
+    struct StudBlock *next;
+    size_t used;
+    size_t capacity;
+    stud records[];
+    
+} StudBlock;
+
+// Allocator handing out student records from large blocks
+typedef struct 
+{
+    StudBlock *blocks;
+    stud *freeList;
+    size_t bytes;
+    
+} StudPool;
+
+// Records in the first pool block; every next block doubles up to the maximum
+#define STUD_POOL_FIRST_BLOCK 64
+#define STUD_POOL_MAX_BLOCK 65536
+
+// Records per block when a sorted list is laid out again in list order, and how
+// many of them are filled; the rest is kept for students added next to them
+#define STUD_LAYOUT_BLOCK 512
+#define STUD_LAYOUT_FILL 448
+
+// Output buffer collecting formatted text before it is written in large pieces
+typedef struct 
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+
+    // Full buffers are written here; NULL keeps all output in memory
+    FILE *sink;
+    
+} OutBuf;
+
+// Size at which a buffer with a sink is flushed
+#define OUTBUF_FLUSH_SIZE (64 * 1024)
+
+// Score band of the performance report; the first band containing a score wins
+typedef struct 
+{
+    const char *title;
+    int minScore;
+    int maxScore;
+    
+} PerfBand;
+
+// Bands of the default performance report
+static const PerfBand defaultPerfBands[] = 
+{
+    { "Excellent", 90, 100 },
+    { "Good", 70, 89 },
+    { "Satisfactory", 50, 69 },
+    { "Unsatisfactory", 0, 49 },
+};
+
+#define DEFAULT_PERF_BAND_COUNT (sizeof(defaultPerfBands) / sizeof(defaultPerfBands[0]))
+
+// Column-oriented copy of the fields filters scan, owned by the list and kept in
+// step with it. Rows follow the list order: a student added at the end takes the
+// next row and a deleted student leaves a dead row; any other change to the order
+// has the rows laid out again before the next scan
+typedef struct 
+{
+    int32_t *age;
+    int32_t *average_score;
+
+    // Record of every row, and one bit per row that is set while the student is in the list
+    stud **student;
+    uint64_t *live;
+
+    size_t count;
+    size_t capacity;
+    size_t dead;
+
+    // The rows match the list; when clear they are laid out again on the next scan
+    int current;
+    
+} StudColumns;
+
+// Filter on age and average score: both ranges are inclusive and equal bounds test for equality
+typedef struct 
+{
+    int32_t minAge;
+    int32_t maxAge;
+    int32_t minScore;
+    int32_t maxScore;
+    
+} StudQuery;
+
+// Numeric student field that rankings and percentiles are taken over
+typedef enum 
+{
+    STUD_FIELD_SCORE,
+    STUD_FIELD_AGE
+    
+} StudField;
+
+// Field a group-by puts students together on
+typedef enum 
+{
+    GROUP_BY_AGE,
+    GROUP_BY_SURNAME,
+    GROUP_BY_BAND
+    
+} GroupKey;
+
+// One group-by: students are grouped on the key and the value field is summarized per group
+typedef struct 
+{
+    GroupKey key;
+    StudField value;
+
+    // Bands for GROUP_BY_BAND; students in no band are left out
+    const PerfBand *bands;
+    size_t bandCount;
+    
+} GroupQuery;
+
+// Students to delete in a batch: a surname, and a name or an empty name for every name
+typedef struct 
+{
+    char surname[20];
+    char name[10];
+    
+} DeleteKey;
+
+// What happens to a student whose surname, name, patronymic and age are already in the list
+typedef enum 
+{
+    DEDUP_KEEP_FIRST,   // The later copy is dropped
+    DEDUP_LAST_WINS,    // The first copy takes the grade of the later one
+    DEDUP_MAX_SCORE     // The first copy keeps the higher of the two grades
+    
+} DedupPolicy;
+
+// Fixed-width student record of the binary roster file
+typedef struct 
+{
+    char surname[20];
+    char name[10];
+    char patronymic[20];
+    char reserved[2];
+    int32_t age;
+    int32_t average_score;
+    
+} StudRecord;
+
+// Header of the binary roster file, followed by count records
+typedef struct 
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t count;
+    uint64_t checksum;
+
+    // Snapshots written by the journal count up; journals older than the snapshot are not replayed
+    uint64_t generation;
+    
+} RosterHeader;
+
+#define ROSTER_MAGIC "STUDROST"
+#define ROSTER_VERSION 2
+
+// Version 1 headers end before the generation
+#define ROSTER_V1_HEADER_SIZE offsetof(RosterHeader, generation)
+
+// Header of the packed roster file, followed by the encoded records. Every
+// record holds its surname, name and patronymic as numbers in one dictionary
+// per field, a word being spelled out where it first appears, then its age
+// and grade as variable-length integers
+typedef struct 
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t checksum;
+    
+} PackHeader;
+
+#define PACK_MAGIC "STUDPACK"
+#define PACK_VERSION 1
+
+// Formats a roster snapshot can be stored in
+typedef enum 
+{
+    ROSTER_TEXT,
+    ROSTER_BINARY,
+    ROSTER_PACKED
+    
+} RosterFormat;
+
+// Append-only log of the changes made since the last full snapshot
+typedef struct 
+{
+    FILE *file;
+    char path[FILENAME_MAX];
+    char snapshotPath[FILENAME_MAX];
+    RosterFormat format;
+    size_t records;
+
+    // Generation of the snapshot the journal applies to
+    uint64_t generation;
+
+    // The previous journal, kept while a background snapshot holding its changes is written
+    char oldPath[FILENAME_MAX];
+    
+} Journal;
+
 // Structure representing the list of students
 typedef struct 
 {
     stud *head;
     stud *tail;
     size_t size;
+
+    SurnameIndex index;
+    OrderIndex order;
+    TrieNode *trie;
+    StudPool pool;
+
+    // Students by average score, for band reports and score ranges
+    BstTree scores;
+
+    // Ages and scores by column, for filters
+    StudColumns columns;
+
+    // Changes are journaled while this is set
+    Journal *journal;
     
 } stud_List;
 
+// The snapshot is rewritten once the journal holds this many records
+// or a quarter of the list size, whichever is larger
+#define JOURNAL_MIN_COMPACT_RECORDS 1024
+
+// Largest request frame, in bytes, the query server accepts
+#define SERVER_MAX_REQUEST (64 * 1024)
+
+// Define LIST_METRICS to time list operations and write them to a Prometheus
+// text file; without it the METRICS_ macros expand to nothing
+#ifdef LIST_METRICS
+
+#ifndef LIST_METRICS_FILE
+#define LIST_METRICS_FILE "students.prom"
+#endif
+
+// Seconds between two writes of the metrics file
+#ifndef LIST_METRICS_INTERVAL
+#define LIST_METRICS_INTERVAL 10
+#endif
+
+// Latency buckets: 1 microsecond doubling up to about 8 seconds, plus one for slower runs
+#define METRICS_BUCKETS 24
+
+// Instrumented operations
+typedef enum 
+{
+    METRIC_LOAD,
+    METRIC_SAVE,
+    METRIC_SORT,
+    METRIC_SEARCH,
+    METRIC_ADD,
+    METRIC_DELETE,
+    METRIC_OPERATIONS
+    
+} MetricOp;
+
+// Totals of one operation; updated with relaxed atomic adds so the server's
+// readers can record concurrently
+typedef struct 
+{
+    uint64_t records;
+    uint64_t bytes;
+    uint64_t nanoseconds;
+    uint64_t buckets[METRICS_BUCKETS + 1];
+    
+} OpMetrics;
+
+#define METRICS_VALUE(type, name, value) type name = (value)
+#define METRICS_START(name) uint64_t name = metricsClock()
+#define METRICS_RECORD(op, start, records, bytes) metricsRecord((op), (start), (uint64_t)(records), (uint64_t)(bytes))
+
+#else
+
+#define METRICS_VALUE(type, name, value)
+#define METRICS_START(name)
+#define METRICS_RECORD(op, start, records, bytes)
+
+#endif
+
 /**
  * @brief Prints the entire student list.
  * @param list A pointer to the student list.
@@ -53,9 +478,68 @@ void addStudBeg(stud_List *list);
  */
 void addStudEnd(stud_List *list);
 
+/**
+ * @brief Adds a copy of the given student data to the beginning of the list.
+ * @param list A pointer to the student list.
+ * @param data The student data to copy.
+ * @return A pointer to the new student, or NULL if memory allocation failed.
+ */
+stud *pushStudBeg(stud_List *list, const stud *data);
+
+/**
+ * @brief Adds a copy of the given student data to the end of the list.
+ * @param list A pointer to the student list.
+ * @param data The student data to copy.
+ * @return A pointer to the new student, or NULL if memory allocation failed.
+ */
+stud *pushStudEnd(stud_List *list, const stud *data);
+
+/**
+ * @brief Allocates a student record from the pool of the list.
+ * @param list A pointer to the student list.
+ * @return A pointer to the uninitialized record, or NULL if memory allocation failed.
+ */
+stud *allocStud(stud_List *list);
+
+/**
+ * @brief Allocates a student record close to another one in memory.
+ * The record comes from the block of the neighbour if it has room left,
+ * so walking the list touches fewer distinct blocks.
+ * @param list A pointer to the student list.
+ * @param neighbour The record the new one will be linked next to, or NULL.
+ * @return A pointer to the uninitialized record, or NULL if memory allocation failed.
+ */
+stud *allocStudNear(stud_List *list, stud *neighbour);
+
+/**
+ * @brief Returns a student record to the pool of the list.
+ * @param list A pointer to the student list.
+ * @param student The record to release.
+ * @return void
+ */
+void freeStud(stud_List *list, stud *student);
+
+/**
+ * @brief Unlinks a student from the list and the surname index and frees it.
+ * @param list A pointer to the student list.
+ * @param student The student to remove.
+ * @return void
+ */
+void removeStudent(stud_List *list, stud *student);
+
+
+/**
+ * @brief Compares two students by surname and then by name.
+ * @param a The first student.
+ * @param b The second student.
+ * @return A negative value, zero or a positive value, like strcmp.
+ */
+int compareStudents(const stud *a, const stud *b);
 
 /**
  * @brief Sorts the student list by surname and name.
+ * The sort is stable. The list is relinked in the order of the ordered index,
+ * and a single student added since the last sort is moved into place directly.
  * @param list A pointer to the student list.
  * @return void
  */
@@ -69,6 +553,15 @@ void sortStudList(stud_List *list);
  */
 void searchAndPrintBySurname(stud_List *list, const char *surname);
 
+/**
+ * @brief Writes the table rows of the students with a given surname.
+ * @param list A pointer to the student list.
+ * @param surname The surname to search for.
+ * @param out The output buffer.
+ * @return The number of students written.
+ */
+size_t writeStudentsBySurname(stud_List *list, const char *surname, OutBuf *out);
+
 /**
  * @brief Deletes all students with a given surname from the list.
  * @param list A pointer to the student list.
@@ -77,6 +570,55 @@ void searchAndPrintBySurname(stud_List *list, const char *surname);
  */
 int del_Nth(stud_List * list, char *surname);
 
+/**
+ * @brief Deletes the students with a given surname and, optionally, name, without asking anything.
+ * @param list A pointer to the student list.
+ * @param surname The surname of the students to delete.
+ * @param name The name of the students to delete, or NULL for any name.
+ * @return The number of students deleted.
+ */
+int deleteStudents(stud_List *list, const char *surname, const char *name);
+
+/**
+ * @brief Deletes every student a predicate selects, in one pass over the list.
+ * Nothing is asked. While the batch runs nothing is journaled; a journaled
+ * list is saved once at the end instead.
+ * @param list A pointer to the student list.
+ * @param match The predicate, returning non-zero for students to delete.
+ * @param context Passed to the predicate.
+ * @return The number of students deleted.
+ */
+size_t deleteStudentsWhere(stud_List *list, int (*match)(const stud *student, void *context), void *context);
+
+/**
+ * @brief Deletes the students matching any of a set of keys.
+ * Every key is looked up in the surname index, so the cost depends on the
+ * number of keys and matches, not on the size of the list. Journaling works
+ * as for deleteStudentsWhere.
+ * @param list A pointer to the student list.
+ * @param keys The keys.
+ * @param count The number of keys.
+ * @return The number of students deleted.
+ */
+size_t deleteStudentsByKeys(stud_List *list, const DeleteKey *keys, size_t count);
+
+/**
+ * @brief Reads deletion keys from a text file, one "surname [name]" per line.
+ * Empty lines are skipped.
+ * @param filename The name of the file.
+ * @param count Receives the number of keys.
+ * @return The keys, to be freed by the caller, or NULL on error.
+ */
+DeleteKey *readDeleteKeys(const char *filename, size_t *count);
+
+/**
+ * @brief Tells whether a student falls in the age and grade ranges of a query.
+ * @param student The student.
+ * @param query A pointer to the StudQuery.
+ * @return Non-zero if both ranges hold the student.
+ */
+int studentInQuery(const stud *student, void *query);
+
 
 /**
  * @brief Finds a student by surname.
@@ -86,6 +628,121 @@ int del_Nth(stud_List * list, char *surname);
  */
 stud *findStudentBySurname(stud_List *list, const char *surname);
 
+/**
+ * @brief Finds the surname index slot holding all students with a given surname.
+ * @param list A pointer to the student list.
+ * @param surname The surname to look up.
+ * @return A pointer to the slot, or NULL if no student has this surname.
+ */
+SurnameSlot *findSurnameSlot(stud_List *list, const char *surname);
+
+/**
+ * @brief Adds a student to the surname, ordered and score indexes.
+ * The student goes next to a list neighbour with the same surname, or first or
+ * last in its chain at either end of the list; anywhere else it is appended
+ * and the chains are put in list order by the next sort. Among students with
+ * the same surname and name in the ordered index it keeps its list order. In
+ * the score index it follows the students with the same score.
+ * @param list A pointer to the student list.
+ * @param student The student, already linked into the list.
+ * @return void
+ */
+void indexStudent(stud_List *list, stud *student);
+
+/**
+ * @brief Removes a student from the surname, ordered and score indexes.
+ * @param list A pointer to the student list.
+ * @param student The student to remove.
+ * @return void
+ */
+void unindexStudent(stud_List *list, stud *student);
+
+/**
+ * @brief Rebuilds the surname index so that every chain follows the list order.
+ * @param list A pointer to the student list.
+ * @return void
+ */
+void rebuildSurnameIndex(stud_List *list);
+
+/**
+ * @brief Lays the columns of the list out again in list order if a change left them behind.
+ * Scans over list->columns call this first.
+ * @param list A pointer to the student list.
+ * @return void
+ */
+void refreshColumns(stud_List *list);
+
+/**
+ * @brief Finds the first student, in surname and name order, whose surname is not less than a given one.
+ * @param list A pointer to the student list.
+ * @param surname The lower bound.
+ * @return A pointer to the student, or NULL if every surname is less.
+ */
+stud *findFirstInOrder(stud_List *list, const char *surname);
+
+/**
+ * @brief Returns the student following a given one in surname and name order.
+ * @param student The current student.
+ * @return A pointer to the next student, or NULL after the last one.
+ */
+stud *nextInOrder(const stud *student);
+
+/**
+ * @brief Writes the students whose surnames lie in a range as table rows, in surname and name order.
+ * The last surname bounds only as many letters as it has, so "M" to "P" includes "Petrov",
+ * and a range from a prefix to the same prefix finds the surnames starting with it.
+ * Only the matching students are visited.
+ * @param list A pointer to the student list.
+ * @param from The first surname of the range.
+ * @param to The last surname of the range.
+ * @param out The output buffer.
+ * @return The number of students written.
+ */
+size_t printStudentsInRange(stud_List *list, const char *from, const char *to, OutBuf *out);
+
+/**
+ * @brief Visits the distinct surnames of the list that start with a prefix.
+ * The cost depends on the prefix length and the number of surnames found.
+ * @param list A pointer to the student list.
+ * @param prefix The prefix; an empty prefix visits every surname.
+ * @param visitor Called for every surname with distance 0.
+ * @param context Passed to the visitor.
+ * @return The number of surnames visited.
+ */
+size_t visitSurnamesByPrefix(stud_List *list, const char *prefix, SurnameVisitor visitor, void *context);
+
+/**
+ * @brief Visits the distinct surnames of the list within an edit distance of a query.
+ * The distance is the Levenshtein distance (insertions, deletions and substitutions);
+ * trie branches that cannot get within the distance are not entered.
+ * @param list A pointer to the student list.
+ * @param query The surname as typed.
+ * @param maxDistance The largest distance accepted.
+ * @param visitor Called for every surname with its distance.
+ * @param context Passed to the visitor.
+ * @return The number of surnames visited.
+ */
+size_t visitSimilarSurnames(stud_List *list, const char *query, int maxDistance, SurnameVisitor visitor, void *context);
+
+/**
+ * @brief Writes the surnames starting with a prefix, each with its number of students.
+ * @param list A pointer to the student list.
+ * @param prefix The prefix.
+ * @param out The output buffer.
+ * @return The number of surnames written.
+ */
+size_t printSurnameCompletions(stud_List *list, const char *prefix, OutBuf *out);
+
+/**
+ * @brief Writes the students whose surnames are within an edit distance of a query as table rows.
+ * @param list A pointer to the student list.
+ * @param query The surname as typed.
+ * @param maxDistance The largest distance accepted.
+ * @param out The output buffer.
+ * @return The number of students written.
+ */
+size_t printStudentsWithSimilarSurname(stud_List *list, const char *query, int maxDistance, OutBuf *out);
+
 /**
  * @brief Adds a new student after a student with a specific surname.
  * @param list A pointer to the student list.
@@ -111,28 +768,258 @@ void printStudByPerf(stud_List *list);
 void printStudentsByPerformanceHelper(stud_List *list, FILE *output); 
 
 /**
- * @brief Frees the memory allocated for the student list.
+ * @brief Prints students grouped into score bands, taken from the score index.
+ * Each band lists its students from the highest score down, followed by their
+ * count, minimum, maximum and mean score. Only the students in the bands are
+ * visited, so a report costs O(log n + students) per band.
  * @param list A pointer to the student list.
+ * @param output A file pointer to write the output.
+ * @param bands The bands, in the order they are printed.
+ * @param bandCount The number of bands.
  * @return void
  */
-void freeList(stud_List *list);
+void printStudentsByBands(stud_List *list, FILE *output, const PerfBand *bands, size_t bandCount);
 
 /**
- * @brief Loads the student list from a file.
+ * @brief Writes the score band report of printStudentsByBands to an output buffer.
  * @param list A pointer to the student list.
- * @param filename The name of the file to load the list from.
+ * @param out The output buffer.
+ * @param bands The bands, in the order they are written.
+ * @param bandCount The number of bands.
  * @return void
  */
-void loadListFromFile(stud_List *list, const char *filename);
+void writeStudentsByBands(stud_List *list, OutBuf *out, const PerfBand *bands, size_t bandCount);
 
 /**
- * @brief Saves the student list to a file.
+ * @brief Writes the students whose average scores lie in a range as table rows, from the lowest score.
+ * Only the matching students are visited in the score index; students with the
+ * same score keep their list order from the last load, and later additions follow.
  * @param list A pointer to the student list.
- * @param filename The name of the file to save the list to.
+ * @param minScore The lowest score, inclusive.
+ * @param maxScore The highest score, inclusive.
+ * @param out The output buffer.
+ * @return The number of students written.
+ */
+size_t printStudentsInScoreRange(stud_List *list, int minScore, int maxScore, OutBuf *out);
+
+/**
+ * @brief Finds the students with the highest or lowest values of a field without sorting the list.
+ * One pass keeps the best k students seen so far in a bounded heap, so it takes
+ * O(n log k) time. Students with equal values keep their list order.
+ * @param list A pointer to the student list.
+ * @param field The field to rank by.
+ * @param k The number of students wanted.
+ * @param highest Non-zero for the highest values, zero for the lowest.
+ * @param result Receives up to k students, best first.
+ * @return The number of students stored, k or the list size if smaller.
+ */
+size_t topStudents(stud_List *list, StudField field, size_t k, int highest, const stud **result);
+
+/**
+ * @brief Writes the students found by topStudents as table rows.
+ * @param list A pointer to the student list.
+ * @param field The field to rank by.
+ * @param k The number of students wanted.
+ * @param highest Non-zero for the highest values, zero for the lowest.
+ * @param out The output buffer.
+ * @return The number of students written.
+ */
+size_t printTopStudents(stud_List *list, StudField field, size_t k, int highest, OutBuf *out);
+
+/**
+ * @brief Computes an exact percentile of a field by selection instead of sorting.
+ * The nearest-rank definition is used: the smallest value that at least the
+ * given percentage of students have or stay below, so percentile 50 is the
+ * lower median and 0 the minimum. Expected time is O(n).
+ * @param list A pointer to the student list.
+ * @param field The field.
+ * @param percent The percentile, from 0 to 100.
+ * @param value Receives the value.
+ * @return 1 on success, 0 if the list is empty or the percentile is out of range.
+ */
+int studentPercentile(stud_List *list, StudField field, double percent, int *value);
+
+/**
+ * @brief Writes the count, sum, minimum, maximum and mean of a field per group.
+ * All group-bys are computed in one pass over the list, each in a hash table
+ * of its groups; the groups are then written in key order, one table per query.
+ * @param list A pointer to the student list.
+ * @param queries The group-bys.
+ * @param queryCount The number of group-bys.
+ * @param out The output buffer.
+ * @return The total number of groups written.
+ */
+size_t writeGroups(stud_List *list, const GroupQuery *queries, size_t queryCount, OutBuf *out);
+
+/**
+ * @brief Prints group-by summaries to a file through a buffered writer.
+ * @param list A pointer to the student list.
+ * @param output A file pointer to write the output.
+ * @param queries The group-bys.
+ * @param queryCount The number of group-bys.
+ * @return void
+ */
+void printGroups(stud_List *list, FILE *output, const GroupQuery *queries, size_t queryCount);
+
+/**
+ * @brief Initializes an output buffer.
+ * @param out A pointer to the buffer.
+ * @param sink The file full buffers are written to, or NULL to keep the output in memory.
+ * @return void
+ */
+void outInit(OutBuf *out, FILE *sink);
+
+/**
+ * @brief Appends bytes to an output buffer.
+ * @param out A pointer to the buffer.
+ * @param text The bytes to append.
+ * @param length The number of bytes.
+ * @return void
+ */
+void outWrite(OutBuf *out, const char *text, size_t length);
+
+/**
+ * @brief Appends formatted text to an output buffer.
+ * @param out A pointer to the buffer.
+ * @param format The printf-style format.
+ * @return void
+ */
+void outPrintf(OutBuf *out, const char *format, ...);
+
+/**
+ * @brief Appends one student as a table row, formatted like printstud_List.
+ * @param out A pointer to the buffer.
+ * @param student The student to format.
+ * @return void
+ */
+void outStudentRow(OutBuf *out, const stud *student);
+
+/**
+ * @brief Writes the buffered output to the sink.
+ * @param out A pointer to the buffer.
+ * @return void
+ */
+void outFlush(OutBuf *out);
+
+/**
+ * @brief Flushes and releases an output buffer.
+ * @param out A pointer to the buffer.
+ * @return void
+ */
+void outFree(OutBuf *out);
+
+/**
+ * @brief Frees the memory allocated for the student list.
+ * @param list A pointer to the student list.
+ * @return void
+ */
+void freeList(stud_List *list);
+
+/**
+ * @brief Loads the student list from a file.
+ * The file is memory-mapped. Binary roster files are recognized by their magic
+ * and copied record by record; text files are parsed field by field the same way
+ * as fscanf("%19s %9s %19s %d %d"): loading stops at the first malformed record.
+ * The journal next to the file, if any, is replayed afterwards.
+ * @param list A pointer to the student list.
+ * @param filename The name of the file to load the list from.
+ * @return void
+ */
+void loadListFromFile(stud_List *list, const char *filename);
+
+/**
+ * @brief Removes the students whose surname, name, patronymic and age repeat an earlier student.
+ * The list is walked once with a hash set of those fields. The earlier student
+ * keeps its place, and its grade is settled by the policy.
+ * @param list A pointer to the student list.
+ * @param policy How the grades of duplicates are merged.
+ * @return The number of students removed.
+ */
+size_t removeDuplicateStudents(stud_List *list, DedupPolicy policy);
+
+/**
+ * @brief Loads a file into the list and merges the students it repeats.
+ * A journaled list is saved once afterwards instead of journaling each change.
+ * @param list A pointer to the student list.
+ * @param filename The name of the file to import.
+ * @param policy How the grades of duplicates are merged.
+ * @return The number of duplicates removed.
+ */
+size_t importListFromFile(stud_List *list, const char *filename, DedupPolicy policy);
+
+/**
+ * @brief Loads a text file into an empty list and sorts it, using several threads.
+ * The file is split at line boundaries; the pieces are parsed and sorted in
+ * parallel and then merged pairwise, every merge again split between the threads.
+ * The result is the same as loadListFromFile followed by sortStudList, which is
+ * what runs instead for binary files, files with a journal, a non-empty list, or
+ * a file where some line does not hold exactly one record.
+ * @param list A pointer to the student list.
+ * @param filename The name of the file to load the list from.
+ * @param threads The number of threads, 0 for one per processor.
+ * @return void
+ */
+void loadSortedListFromFile(stud_List *list, const char *filename, int threads);
+
+/**
+ * @brief Saves the student list to a file.
+ * @param list A pointer to the student list.
+ * @param filename The name of the file to save the list to.
  * @return void
  */
 void saveListToFile(stud_List *list, const char *filename);
 
+/**
+ * @brief Saves the student list to a binary roster file.
+ * The file holds a header (magic, version, record count, checksum) and
+ * fixed-width records, so loading it needs no parsing.
+ * @param list A pointer to the student list.
+ * @param filename The name of the file to save the list to.
+ * @return 1 on success, 0 on failure.
+ */
+int saveListToBinaryFile(stud_List *list, const char *filename);
+
+/**
+ * @brief Saves the student list to a packed roster file.
+ * Surnames, names and patronymics are replaced by numbers in a dictionary per
+ * field, stored as the difference from the previous record's number, and ages
+ * and grades are stored as variable-length integers, so a roster with many
+ * repeated names takes a fraction of the size of the text file. The file is
+ * decoded in one streaming pass on load.
+ * @param list A pointer to the student list.
+ * @param filename The name of the file to save the list to.
+ * @return 1 on success, 0 on failure.
+ */
+int saveListToPackedFile(stud_List *list, const char *filename);
+
+/**
+ * @brief Saves the student list in the given format.
+ * @param list A pointer to the student list.
+ * @param filename The name of the file to save the list to.
+ * @param format The format of the file.
+ * @return void
+ */
+void saveRoster(stud_List *list, const char *filename, RosterFormat format);
+
+/**
+ * @brief Saves the student list on a background thread and returns at once.
+ * The records are copied first, so the list may change while the copy is
+ * written to a temporary file, flushed to disk and moved into place. A save
+ * still waiting for the one before it is replaced by a newer save of the
+ * same file. Without threads the list is saved before returning.
+ * @param list A pointer to the student list.
+ * @param filename The name of the file to save the list to.
+ * @param format The format of the file.
+ * @return void
+ */
+void saveRosterInBackground(stud_List *list, const char *filename, RosterFormat format);
+
+/**
+ * @brief Waits until every background save has been written.
+ * @return void
+ */
+void waitForBackgroundSaves(void);
+
 /**
  * @brief Prints students by performance categories to a specified file.
  * @param list A pointer to the student list.
@@ -141,641 +1028,7993 @@ void saveListToFile(stud_List *list, const char *filename);
  */
 void printStudentsByPerformanceToFile(stud_List *list, const char *filename);
 
-int main() 
-{
-    stud_List *list = createList();
-    
-    loadListFromFile(list, "students.txt");
-    
-    int choice;
-    
-    char surname[20], name[10], patronymic[20];
-    int age, average_score;
+/**
+ * @brief Sorts a text roster file that may be larger than memory.
+ * The input is read sequentially in runs that fit the memory limit; every run
+ * is sorted and spilled to a temporary file, and the runs are merged k ways at a
+ * time, in several passes if there are too many, into a text file of the same
+ * format. Records are read the same way as loadListFromFile and the order is
+ * the stable order of sortStudList.
+ * @param input The name of the text file to sort.
+ * @param output The name of the sorted file.
+ * @param memoryLimit The memory, in bytes, the sort may use for records and buffers.
+ * @param count Receives the number of students sorted, may be NULL.
+ * @return 1 on success, 0 on failure.
+ */
+int externalSortFile(const char *input, const char *output, size_t memoryLimit, uint64_t *count);
 
-    do {
-        printf("\nMenu:\n");
-        printf("1. Add a student to the start of the list\n");
-        printf("2. Add a student to the end of the list\n");
-        printf("3. Add a student after a specific surname\n");
-        printf("4. View the entire group\n");
-        printf("5. Search for students by surname\n");
-        printf("6. Withdrawal of students by performance\n");
-        printf("7. Delete a student with a given surname\n");
-        printf("8. Exit\n");
-        printf("Enter your choice: ");
-        scanf("%d", &choice);
+/**
+ * @brief Starts journaling list changes next to a snapshot file.
+ * Changes are appended to "<snapshot>.journal" instead of rewriting the snapshot.
+ * @param list A pointer to the student list.
+ * @param snapshotPath The name of the snapshot file.
+ * @param format The format the snapshot is written in on compaction.
+ * @return 1 on success, 0 if the journal could not be opened.
+ */
+int journalOpen(stud_List *list, const char *snapshotPath, RosterFormat format);
 
-        switch (choice) 
-		{
-            case 1:
-                addStudBeg(list);
+/**
+ * @brief Writes the full snapshot and empties the journal.
+ * Background snapshots are waited for first. If the snapshot cannot be
+ * written the journal is kept.
+ * @param list A pointer to the student list.
+ * @return void
+ */
+void journalCompact(stud_List *list);
 
-                printf("\nUnsorted: ");
-                printstud_List(list);
+/**
+ * @brief Starts writing the full snapshot in the background and empties the journal.
+ * The journal is renamed to "<journal>.old" and new changes go to a fresh
+ * journal; the old one is removed once the snapshot is on disk. A request made
+ * while a snapshot of the list is still being written is skipped, the next
+ * change asks again.
+ * @param list A pointer to the student list.
+ * @return void
+ */
+void journalCompactInBackground(stud_List *list);
 
-                sortStudList(list);
-            	saveListToFile(list, "students.txt");
-                break;
-            case 2:
-            	addStudEnd(list);
+/**
+ * @brief Compacts and closes the journal of the list.
+ * The snapshot is not rewritten when no change was journaled since it was written.
+ * @param list A pointer to the student list.
+ * @return void
+ */
+void journalClose(stud_List *list);
 
-                printf("\nUnsorted: ");
-                printstud_List(list);
+/**
+ * @brief Applies the changes recorded in a journal file to the list.
+ * A journal written for an older snapshot than the loaded one is skipped,
+ * its changes are already in the snapshot.
+ * @param list A pointer to the student list.
+ * @param journalPath The name of the journal file.
+ * @param generation The generation of the loaded snapshot.
+ * @return The number of records applied.
+ */
+size_t replayJournal(stud_List *list, const char *journalPath, uint64_t generation);
 
-            	sortStudList(list);
-            	saveListToFile(list, "students.txt");
-                break;
-            case 3:
-            	printf("Enter the surname to add a new student after: ");
-    			scanf("%49s", surname);
-    
-    			stud *newStudentData = malloc(sizeof(stud));
-    			if (newStudentData == NULL) 
-				{
-        			printf("Memory allocation failed.\n");
-        			exit(EXIT_FAILURE);
-    			}
-    
-    			printf("\nEnter surname: ");
-    			scanf("%19s", newStudentData->surname);
-    			printf("Enter name: ");
-    			scanf("%9s", newStudentData->name);
-    			printf("Enter patronymic: ");
-   		 		scanf("%19s", newStudentData->patronymic);
-    			printf("Enter age: ");
-    			scanf("%d", &newStudentData->age);
-    			printf("Enter average grade: ");
-    			scanf("%d", &newStudentData->average_score);
+/**
+ * @brief Loads the working copy into an empty list and starts journaling.
+ * The binary roster students.bin is loaded if it exists, otherwise students.txt
+ * is imported; changes then go to students.bin.journal.
+ * @param list A pointer to the student list.
+ * @return void
+ */
+void openWorkingCopy(stud_List *list);
 
-				addStudentAfter(list, surname, newStudentData);
+/**
+ * @brief Runs one text request against the list and writes the response.
+ * Requests are a command word followed by arguments separated by spaces:
+ * PING, COUNT, LIST, SEARCH surname, PREFIX prefix, RANGE first last,
+ * SIMILAR surname [distance], REPORT, FILTER minAge maxAge minGrade maxGrade,
+ * TOP n [grade|age], BOTTOM n [grade|age], PERCENTILE p [grade|age],
+ * GROUP age|surname|band... [OF grade|age],
+ * ADD BEG|END surname name patronymic age grade,
+ * ADD AFTER surname surname name patronymic age grade and DELETE surname [name].
+ * The response starts with "OK n", n being the number of students listed or
+ * changed, or with "ERR message"; listed students follow as table rows.
+ * PERCENTILE answers with the number of students and the value on its own line,
+ * GROUP with the number of groups and a table per key.
+ * @param list A pointer to the student list.
+ * @param request The request text.
+ * @param out The output buffer receiving the response.
+ * @return 1 if the request changes the list, 0 if it only reads it.
+ */
+int executeRequest(stud_List *list, const char *request, OutBuf *out);
 
-                printf("\nUnsorted: ");
-                printstud_List(list);
+/**
+ * @brief Tells whether a request changes the list.
+ * @param request The request text.
+ * @return 1 for ADD and DELETE requests, 0 otherwise.
+ */
+int requestChangesList(const char *request);
 
-				sortStudList(list);
-                saveListToFile(list, "students.txt");
-                break;
-            case 4:
-                printstud_List(list);
-                saveListToFile(list, "students.txt");
-                break;
-            case 5:
-                printf("Enter the surname to search: ");
-    			scanf("%49s", surname);
-    			
-    			searchAndPrintBySurname(list, surname);
-                break;
-            case 6:
-                printStudByPerf(list); 
-            	printStudentsByPerformanceToFile(list, "grades.txt");
-            	break;
-            case 7:
-                printf("Enter the surname of students to delete: ");
-                scanf("%49s", surname);
+#ifdef LIST_SERVER
+/**
+ * @brief Serves requests on a Unix domain socket until SIGINT or SIGTERM.
+ * Every frame, in both directions, is a 4-byte big-endian length followed by
+ * that many bytes of text; requests and responses are as for executeRequest.
+ * One epoll loop does all socket I/O and hands requests to worker threads;
+ * reads run in parallel under a shared lock, changes one at a time.
+ * @param list A pointer to the student list.
+ * @param socketPath The path of the socket; an existing socket file is replaced.
+ * @param workers The number of worker threads.
+ * @return 1 after a clean shutdown, 0 if the server could not start.
+ */
+int runServer(stud_List *list, const char *socketPath, int workers);
 
-                int deletedCount = del_Nth(list, surname);
-    
-                if (deletedCount > 0) 
-                {
-                    printf("%d students with the surname %s were deleted.\n", deletedCount, surname);
-                } else {
-                    printf("No students with the surname %s found.\n", surname);
-                }
+/**
+ * @brief Sends one request to a server and writes the response.
+ * @param socketPath The path of the server socket.
+ * @param request The request text.
+ * @param output The file the response is written to.
+ * @return 1 if the server answered OK, 0 otherwise.
+ */
+int queryServer(const char *socketPath, const char *request, FILE *output);
+#endif
+
+#ifdef LIST_METRICS
+/**
+ * @brief Reads the monotonic clock used by the metrics.
+ * @return The time in nanoseconds.
+ */
+uint64_t metricsClock(void);
+
+/**
+ * @brief Records one run of an operation.
+ * @param op The operation.
+ * @param start The clock reading taken when the operation started.
+ * @param records The number of students the operation loaded, saved, sorted, found, added or deleted.
+ * @param bytes The number of bytes it read or wrote.
+ * @return void
+ */
+void metricsRecord(MetricOp op, uint64_t start, uint64_t records, uint64_t bytes);
+
+/**
+ * @brief Writes the metrics and the gauges of a list in Prometheus text format.
+ * The file is written under a temporary name and moved into place.
+ * @param list A pointer to the student list.
+ * @param path The name of the metrics file.
+ * @return 1 on success, 0 on error.
+ */
+int metricsWrite(stud_List *list, const char *path);
+
+/**
+ * @brief Writes LIST_METRICS_FILE if LIST_METRICS_INTERVAL seconds passed since the last write.
+ * @param list A pointer to the student list.
+ * @return void
+ */
+void metricsTick(stud_List *list);
+#endif
+
+/**
+ * @brief Writes a synthetic text roster.
+ * Surnames follow a Zipf distribution over a vocabulary that grows with the
+ * roster, so a few surnames are very common and most are rare; names, ages
+ * and grades are drawn independently. The same rows and seed always give the
+ * same file.
+ * @param filename The name of the file to write.
+ * @param rows The number of students.
+ * @param seed The seed of the random generator.
+ * @return 1 on success, 0 on error.
+ */
+int generateRoster(const char *filename, uint64_t rows, uint64_t seed);
+
+/**
+ * @brief Benchmarks the list on a generated roster and writes the results as JSON.
+ * Loading, sorting, the performance report and saving are timed once per
+ * round on a fresh list; searches and deletions by surname are timed one by
+ * one on the last round. Every operation is reported with its throughput and
+ * latency percentiles. The roster and the saved copy are written to the
+ * current directory and removed afterwards.
+ * @param rows The number of students.
+ * @param rounds The number of rounds.
+ * @param seed The seed of the random generator.
+ * @param output The file the JSON report is written to.
+ * @return 1 on success, 0 on error.
+ */
+int runBenchmark(uint64_t rows, int rounds, uint64_t seed, FILE *output);
+
+/**
+ * @brief Evaluates a filter over the age and score columns.
+ * Uses AVX2 or SSE2 kernels when the CPU supports them, scalar code otherwise.
+ * Dead rows never match.
+ * @param columns A pointer to the columns.
+ * @param query The filter to apply.
+ * @param bitmap Receives one bit per row; must hold (count + 63) / 64 words.
+ * @return The number of matching students.
+ */
+size_t filterColumns(const StudColumns *columns, const StudQuery *query, uint64_t *bitmap);
+
+/**
+ * @brief Filters the students of the list over its columns.
+ * The columns are kept in step with the list, so a filter scans only the age
+ * and score columns; they are laid out again first if the list order changed
+ * since the last filter.
+ * @param list A pointer to the student list.
+ * @param query The filter to apply.
+ * @param matches Receives the number of matching students, may be NULL.
+ * @return A bitmap over the rows of list->columns, to be released with free.
+ */
+uint64_t *selectStudents(stud_List *list, const StudQuery *query, size_t *matches);
+
+/**
+ * @brief Writes the selected students in list order as table rows.
+ * @param columns A pointer to the columns.
+ * @param bitmap The selection bitmap.
+ * @param out The output buffer.
+ * @return void
+ */
+void columnsPrintSelection(const StudColumns *columns, const uint64_t *bitmap, OutBuf *out);
+
+/**
+ * @brief Prints the performance report of the selected students.
+ * @param columns A pointer to the columns.
+ * @param bitmap The selection bitmap.
+ * @param output A file pointer to write the output.
+ * @param bands The bands, in the order they are printed.
+ * @param bandCount The number of bands.
+ * @return void
+ */
+void columnsPrintSelectionByBands(const StudColumns *columns, const uint64_t *bitmap, FILE *output, const PerfBand *bands, size_t bandCount);
+
+int main(int argc, char *argv[]) 
+{
+    if (argc >= 4 && strcmp(argv[1], "--sort") == 0) 
+    {
+        // Sort a text roster without the menu: list --sort in out [threads]
+        stud_List *sorted = createList();
+        loadSortedListFromFile(sorted, argv[2], argc >= 5 ? atoi(argv[4]) : 0);
+        saveListToFile(sorted, argv[3]);
+        printf("%zu students sorted into %s\n", sorted->size, argv[3]);
+        freeList(sorted);
+        return 0;
+    }
+
+    if (argc >= 4 && strcmp(argv[1], "--external-sort") == 0) 
+    {
+        // Sort a roster larger than memory: list --external-sort in out [memMB]
+        size_t megabytes = argc >= 5 ? (size_t)strtoul(argv[4], NULL, 10) : 64;
+        uint64_t count;
+
+        if (!externalSortFile(argv[2], argv[3], megabytes * 1024 * 1024, &count)) return EXIT_FAILURE;
+        printf("%llu students sorted into %s\n", (unsigned long long)count, argv[3]);
+        return 0;
+    }
+
+    if (argc >= 4 && strcmp(argv[1], "--convert") == 0) 
+    {
+        // Convert a roster to another format: list --convert input output [text|binary|packed]
+        const char *formatName = argc > 4 ? argv[4] : "packed";
+        RosterFormat format = ROSTER_PACKED;
+
+        if (strcmp(formatName, "text") == 0) 
+        {
+            format = ROSTER_TEXT;
+        } 
+        
+        else if (strcmp(formatName, "binary") == 0) 
+        {
+            format = ROSTER_BINARY;
+        } 
+        
+        else if (strcmp(formatName, "packed") != 0) 
+        {
+            fprintf(stderr, "Unknown roster format %s, expected text, binary or packed\n", formatName);
+            return EXIT_FAILURE;
+        }
+
+        stud_List *roster = createList();
+        loadListFromFile(roster, argv[2]);
+        saveRoster(roster, argv[3], format);
+        printf("%zu students written to %s\n", roster->size, argv[3]);
+
+        freeList(roster);
+        return 0;
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--import") == 0) 
+    {
+        // Import a roster into the working copy, merging duplicates: list --import file [first|last|max]
+        const char *policyName = argc > 3 ? argv[3] : "first";
+        DedupPolicy policy = DEDUP_KEEP_FIRST;
+
+        if (strcmp(policyName, "last") == 0) 
+        {
+            policy = DEDUP_LAST_WINS;
+        } 
+        
+        else if (strcmp(policyName, "max") == 0) 
+        {
+            policy = DEDUP_MAX_SCORE;
+        } 
+        
+        else if (strcmp(policyName, "first") != 0) 
+        {
+            fprintf(stderr, "Unknown duplicate policy %s, expected first, last or max\n", policyName);
+            return EXIT_FAILURE;
+        }
+
+        stud_List *roster = createList();
+        openWorkingCopy(roster);
+        size_t sizeBefore = roster->size;
+        size_t removed = importListFromFile(roster, argv[2], policy);
+        printf("%zu students read, %zu duplicates removed, %zu in the list\n",
+               roster->size + removed - sizeBefore, removed, roster->size);
+
+        journalClose(roster);
+        freeList(roster);
+        return 0;
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--delete-from") == 0) 
+    {
+        // Delete the students listed in a file from the working copy: list --delete-from keys
+        size_t count;
+        DeleteKey *keys = readDeleteKeys(argv[2], &count);
+        if (keys == NULL) return EXIT_FAILURE;
+
+        stud_List *roster = createList();
+        openWorkingCopy(roster);
+        size_t deleted = deleteStudentsByKeys(roster, keys, count);
+        printf("%zu students deleted for %zu keys, %zu left\n", deleted, count, roster->size);
+
+        journalClose(roster);
+        freeList(roster);
+        free(keys);
+        return 0;
+    }
+
+    if (argc >= 6 && strcmp(argv[1], "--delete-where") == 0) 
+    {
+        // Delete the students in age and grade ranges: list --delete-where minAge maxAge minGrade maxGrade
+        StudQuery query = { atoi(argv[2]), atoi(argv[3]), atoi(argv[4]), atoi(argv[5]) };
+
+        stud_List *roster = createList();
+        openWorkingCopy(roster);
+        size_t deleted = deleteStudentsWhere(roster, studentInQuery, &query);
+        printf("%zu students deleted, %zu left\n", deleted, roster->size);
+
+        journalClose(roster);
+        freeList(roster);
+        return 0;
+    }
+
+    if (argc >= 4 && strcmp(argv[1], "--generate") == 0) 
+    {
+        // Write a synthetic roster: list --generate rows file [seed]
+        uint64_t rows = strtoull(argv[2], NULL, 10);
+        uint64_t seed = argc >= 5 ? strtoull(argv[4], NULL, 10) : 1;
+
+        if (!generateRoster(argv[3], rows, seed)) return EXIT_FAILURE;
+        printf("%llu students written to %s\n", (unsigned long long)rows, argv[3]);
+        return 0;
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--bench") == 0) 
+    {
+        // Benchmark on a synthetic roster: list --bench rows [rounds] [seed]
+        uint64_t rows = strtoull(argv[2], NULL, 10);
+        int rounds = argc >= 4 ? atoi(argv[3]) : 3;
+        uint64_t seed = argc >= 5 ? strtoull(argv[4], NULL, 10) : 1;
+
+        return runBenchmark(rows, rounds, seed, stdout) ? 0 : EXIT_FAILURE;
+    }
+
+#ifdef LIST_SERVER
+    if (argc >= 3 && strcmp(argv[1], "--serve") == 0) 
+    {
+        // Answer queries over a Unix domain socket: list --serve socket [workers]
+        stud_List *served = createList();
+        openWorkingCopy(served);
+
+        int status = runServer(served, argv[2], argc >= 4 ? atoi(argv[3]) : 4);
+
+        journalClose(served);
+        freeList(served);
+        return status ? 0 : EXIT_FAILURE;
+    }
+
+    if (argc >= 4 && strcmp(argv[1], "--query") == 0) 
+    {
+        // Send one request to a server: list --query socket COMMAND [arguments]
+        char request[SERVER_MAX_REQUEST];
+        size_t length = 0;
+        request[0] = '\0';
+
+        for (int i = 3; i < argc; i++) 
+        {
+            int written = snprintf(request + length, sizeof(request) - length, "%s%s", i > 3 ? " " : "", argv[i]);
+            if (written < 0 || (size_t)written >= sizeof(request) - length) 
+            {
+                fprintf(stderr, "Request too long\n");
+                return EXIT_FAILURE;
+            }
+            length += (size_t)written;
+        }
+
+        return queryServer(argv[2], request, stdout) ? 0 : EXIT_FAILURE;
+    }
+#endif
+
+    if (argc > 1) 
+    {
+        printf("Usage: %s [--sort input output [threads] | --external-sort input output [memMB]", argv[0]);
+        printf(" | --generate rows file [seed] | --bench rows [rounds] [seed]");
+        printf(" | --convert input output [text|binary|packed] | --import file [first|last|max]");
+        printf(" | --delete-from keys | --delete-where minAge maxAge minGrade maxGrade");
+#ifdef LIST_SERVER
+        printf(" | --serve socket [workers] | --query socket command [arguments]");
+#endif
+        printf("]\n");
+        return EXIT_FAILURE;
+    }
+
+    stud_List *list = createList();
+    openWorkingCopy(list);
+    
+    int choice;
+    
+    char surname[20], name[10], patronymic[20];
+    int age, average_score;
+
+    do {
+        printf("\nMenu:\n");
+        printf("1. Add a student to the start of the list\n");
+        printf("2. Add a student to the end of the list\n");
+        printf("3. Add a student after a specific surname\n");
+        printf("4. View the entire group\n");
+        printf("5. Search for students by surname\n");
+        printf("6. Withdrawal of students by performance\n");
+        printf("7. Delete a student with a given surname\n");
+        printf("8. Exit\n");
+        printf("9. Export the group to students.txt\n");
+        printf("10. Filter students by age and grade\n");
+        printf("11. Search for students in a surname range\n");
+        printf("12. Find students by a partial or mistyped surname\n");
+        printf("13. Show the best or worst students and percentiles\n");
+        printf("14. Summarize grades by age, surname or performance band\n");
+        printf("15. Search for students in a grade range\n");
+        printf("Enter your choice: ");
+
+        // End of input or anything but a number ends the session like Exit
+        if (scanf("%d", &choice) != 1) choice = 8;
+
+        switch (choice) 
+		{
+            case 1:
+                addStudBeg(list);
+
+                printf("\nUnsorted: ");
+                printstud_List(list);
+
+                sortStudList(list);
+                break;
+            case 2:
+            	addStudEnd(list);
+
+                printf("\nUnsorted: ");
+                printstud_List(list);
+
+            	sortStudList(list);
+                break;
+            case 3:
+            	printf("Enter the surname to add a new student after: ");
+    			scanf("%49s", surname);
+    
+    			stud *newStudentData = malloc(sizeof(stud));
+    			if (newStudentData == NULL) 
+				{
+        			printf("Memory allocation failed.\n");
+        			exit(EXIT_FAILURE);
+    			}
+    
+    			printf("\nEnter surname: ");
+    			scanf("%19s", newStudentData->surname);
+    			printf("Enter name: ");
+    			scanf("%9s", newStudentData->name);
+    			printf("Enter patronymic: ");
+   		 		scanf("%19s", newStudentData->patronymic);
+    			printf("Enter age: ");
+    			scanf("%d", &newStudentData->age);
+    			printf("Enter average grade: ");
+    			scanf("%d", &newStudentData->average_score);
+
+				addStudentAfter(list, surname, newStudentData);
+
+                printf("\nUnsorted: ");
+                printstud_List(list);
+
+				sortStudList(list);
+                break;
+            case 4:
+                printstud_List(list);
+                break;
+            case 5: {
+                printf("Enter the surname to search (Rod* for a prefix): ");
+    			scanf("%19s", surname);
+
+                size_t length = strlen(surname);
+                if (length > 0 && surname[length - 1] == '*') 
+                {
+                    // A prefix is the range from the prefix to itself
+                    surname[length - 1] = '\0';
+
+                    printf("\n%-20s %-10s %-20s %-10s %-10s\n", "Surname", "Name", "Patronymic", "Age", "Grade");
+                    printf("-------------------------------------------------------------------------------\n");
+
+                    OutBuf out;
+                    outInit(&out, stdout);
+                    size_t found = printStudentsInRange(list, surname, surname, &out);
+                    outFree(&out);
+
+                    printf("%zu students found.\n", found);
+                    break;
+                }
+    			
+    			searchAndPrintBySurname(list, surname);
+                break;
+            }
+            case 6:
+                printStudByPerf(list); 
+            	printStudentsByPerformanceToFile(list, "grades.txt");
+            	break;
+            case 7:
+                printf("Enter the surname of students to delete: ");
+                scanf("%49s", surname);
+
+                int deletedCount = del_Nth(list, surname);
+    
+                if (deletedCount > 0) 
+                {
+                    printf("%d students with the surname %s were deleted.\n", deletedCount, surname);
+                } else {
+                    printf("No students with the surname %s found.\n", surname);
+                }
+                break;
+            case 9:
+                // The file is written in the background; the menu is back at once
+                saveRosterInBackground(list, "students.txt", ROSTER_TEXT);
+                printf("%zu students exported to students.txt\n", list->size);
+                break;
+            case 10: {
+                StudQuery query;
+                printf("Enter the age range (min max): ");
+                scanf("%d %d", &query.minAge, &query.maxAge);
+                printf("Enter the grade range (min max): ");
+                scanf("%d %d", &query.minScore, &query.maxScore);
+
+                // The filter kernels work on the columnar copy kept with the list
+                size_t matches;
+                uint64_t *selection = selectStudents(list, &query, &matches);
+
+                printf("\n%-20s %-10s %-20s %-10s %-10s\n", "Surname", "Name", "Patronymic", "Age", "Grade");
+                printf("-------------------------------------------------------------------------------\n");
+
+                OutBuf out;
+                outInit(&out, stdout);
+                columnsPrintSelection(&list->columns, selection, &out);
+                outFree(&out);
+
+                printf("%zu students match.\n", matches);
+                if (matches > 0) 
+                {
+                    columnsPrintSelectionByBands(&list->columns, selection, stdout, defaultPerfBands, DEFAULT_PERF_BAND_COUNT);
+                }
+
+                free(selection);
+                break;
+            }
+            case 11: {
+                char last[20];
+                printf("Enter the first and the last surname of the range: ");
+                scanf("%19s %19s", surname, last);
+
+                printf("\n%-20s %-10s %-20s %-10s %-10s\n", "Surname", "Name", "Patronymic", "Age", "Grade");
+                printf("-------------------------------------------------------------------------------\n");
+
+                OutBuf out;
+                outInit(&out, stdout);
+                size_t found = printStudentsInRange(list, surname, last, &out);
+                outFree(&out);
+
+                printf("%zu students found.\n", found);
+                break;
+            }
+            case 12: {
+                printf("Enter the surname or its beginning: ");
+                scanf("%19s", surname);
+
+                OutBuf out;
+                outInit(&out, stdout);
+
+                outPrintf(&out, "\nSurnames starting with '%s':\n", surname);
+                if (printSurnameCompletions(list, surname, &out) == 0) 
+                {
+                    outPrintf(&out, "None.\n");
+                }
+
+                // Short surnames allow fewer typos, or nearly everything would match
+                int maxDistance = strlen(surname) <= 4 ? 1 : 2;
+
+                outPrintf(&out, "\nStudents with a surname within %d typo%s of '%s':\n", 
+                          maxDistance, maxDistance == 1 ? "" : "s", surname);
+                outPrintf(&out, "%-20s %-10s %-20s %-10s %-10s\n", "Surname", "Name", "Patronymic", "Age", "Grade");
+                outPrintf(&out, "-------------------------------------------------------------------------------\n");
+                size_t found = printStudentsWithSimilarSurname(list, surname, maxDistance, &out);
+                outPrintf(&out, "%zu students found.\n", found);
+
+                outFree(&out);
+                break;
+            }
+            case 13: {
+                int wanted;
+                printf("Enter the number of students (negative for the lowest grades): ");
+                scanf("%d", &wanted);
+
+                OutBuf out;
+                outInit(&out, stdout);
+
+                outPrintf(&out, "\n%-20s %-10s %-20s %-10s %-10s\n", "Surname", "Name", "Patronymic", "Age", "Grade");
+                outPrintf(&out, "-------------------------------------------------------------------------------\n");
+                size_t shown = printTopStudents(list, STUD_FIELD_SCORE, 
+                                                (size_t)(wanted < 0 ? -(long)wanted : wanted), wanted >= 0, &out);
+                outPrintf(&out, "%zu students shown.\n", shown);
+
+                // Each percentile is an O(n) selection, no sorting needed
+                static const int percents[] = { 0, 10, 25, 50, 75, 90, 100 };
+                static const char *const titles[] = { "min", "10%", "25%", "median", "75%", "90%", "max" };
+
+                for (int f = 0; f < 2 && list->size > 0; f++) 
+                {
+                    StudField field = f == 0 ? STUD_FIELD_SCORE : STUD_FIELD_AGE;
+                    outPrintf(&out, "%s:", f == 0 ? "Grade" : "Age");
+                    for (size_t i = 0; i < sizeof(percents) / sizeof(percents[0]); i++) 
+                    {
+                        int value;
+                        studentPercentile(list, field, percents[i], &value);
+                        outPrintf(&out, " %s %d%s", titles[i], value, i + 1 < sizeof(percents) / sizeof(percents[0]) ? "," : "\n");
+                    }
+                }
+
+                outFree(&out);
+                break;
+            }
+            case 14: {
+                int by;
+                printf("Group by (1 - age, 2 - surname, 3 - performance band, 0 - all three): ");
+                scanf("%d", &by);
+
+                GroupQuery queries[] = 
+                {
+                    { GROUP_BY_AGE, STUD_FIELD_SCORE, NULL, 0 },
+                    { GROUP_BY_SURNAME, STUD_FIELD_SCORE, NULL, 0 },
+                    { GROUP_BY_BAND, STUD_FIELD_SCORE, defaultPerfBands, DEFAULT_PERF_BAND_COUNT },
+                };
+
+                if (by < 0 || by > 3) 
+                {
+                    printf("Invalid choice, please try again.\n");
+                    break;
+                }
+
+                // All three summaries come from the same pass over the list
+                printGroups(list, stdout, by == 0 ? queries : &queries[by - 1], by == 0 ? 3 : 1);
+                break;
+            }
+            case 15: {
+                int minScore, maxScore;
+                printf("Enter the lowest and the highest grade: ");
+                scanf("%d %d", &minScore, &maxScore);
+
+                printf("\n%-20s %-10s %-20s %-10s %-10s\n", "Surname", "Name", "Patronymic", "Age", "Grade");
+                printf("-------------------------------------------------------------------------------\n");
+
+                OutBuf out;
+                outInit(&out, stdout);
+                size_t found = printStudentsInScoreRange(list, minScore, maxScore, &out);
+                outFree(&out);
+
+                printf("%zu students found.\n", found);
+                break;
+            }
+            case 8:
+                printf("Exiting...\n");
+                journalClose(list);
+                waitForBackgroundSaves();
+#ifdef LIST_METRICS
+                metricsWrite(list, LIST_METRICS_FILE);
+#endif
+                freeList(list);
+                break;
+            default:
+                printf("Invalid choice, please try again.\n");
+        }
+
+#ifdef LIST_METRICS
+        if (choice != 8) metricsTick(list);
+#endif
+    } while (choice != 8);
+
+    return 0;
+}
+
+void printstud_List(stud_List *list) 
+{
+    // Check if the list is empty
+    if (list == NULL || list->head == NULL) 
+	{
+        printf("The list is empty.\n");
+        return;
+    }
+
+    stud *current = list->head;
+    
+    // Print table header
+    printf("\n%-20s %-10s %-20s %-10s %-10s\n", "Surname", "Name", "Patronymic", "Age", "Grade");
+    printf("-------------------------------------------------------------------------------\n");
+    
+    // Go through and print all elements of the list
+    while (current != NULL) 
+	{
+        printf("%-20s %-10s %-20s %-10d %-10d\n", 
+               current->surname, 
+               current->name, 
+               current->patronymic, 
+               current->age, 
+               current->average_score);
+        current = current->next;
+    }
+    printf("\n");
+}
+
+stud_List* createList() 
+{
+    // Allocate memory for the new list structure
+	stud_List *tmp = (stud_List*) malloc(sizeof(stud_List));
+    
+    if (tmp == NULL) 
+	{
+        // If memory is not allocated, print an error message
+        printf("Error allocating memory\n");
+        return NULL;
+    }
+    
+    // Initialize pointers and list size
+    tmp->head = tmp->tail = NULL;
+    tmp->size = 0;
+
+    // The surname index is allocated on the first insertion
+    tmp->index.slots = NULL;
+    tmp->index.capacity = 0;
+    tmp->index.used = 0;
+    tmp->index.stale = 0;
+
+    // The columns are filled by the first scan
+    memset(&tmp->columns, 0, sizeof(tmp->columns));
+
+    // So is the head of the ordered index
+    tmp->order.head = NULL;
+    tmp->order.level = 1;
+    tmp->order.seed = 2463534242u;
+    tmp->order.sorted = 1;
+    tmp->order.displaced = NULL;
+
+    tmp->trie = NULL;
+
+    bstInit(&tmp->scores);
+
+    tmp->pool.blocks = NULL;
+    tmp->pool.freeList = NULL;
+    tmp->pool.bytes = 0;
+
+    tmp->journal = NULL;
+    
+    return tmp;
+}
+
+void addStudBeg(stud_List *list) 
+{
+    stud data;
+	
+    // Read student data from the keyboard
+	printf("\nEnter surname: ");
+    scanf("%19s", data.surname);
+    printf("Enter name: ");
+    scanf("%9s", data.name);
+    printf("Enter patronymic: ");
+    scanf("%19s", data.patronymic);
+    
+    printf("Enter age: ");
+    scanf("%d", &data.age);
+    
+    printf("Enter average Grade: ");
+    scanf("%d", &data.average_score);
+
+    pushStudBeg(list, &data);
+}
+
+void addStudEnd(stud_List *list) 
+{
+    stud data;
+
+    // Read student data from the keyboard
+    printf("\nEnter surname: ");
+    scanf("%19s", data.surname);
+    printf("Enter name: ");
+    scanf("%9s", data.name);
+    printf("Enter patronymic: ");
+    scanf("%19s", data.patronymic);
+    printf("Enter age: ");
+    scanf("%d", &data.age);
+    printf("Enter average Grade: ");
+    scanf("%d", &data.average_score);
+
+    pushStudEnd(list, &data);
+}
+
+/**
+ * @brief Appends one change record to the journal of the list, if any.
+ * The snapshot is rewritten once enough records have piled up.
+ * @param list A pointer to the student list.
+ * @param op The operation code: B, E, A, D or S.
+ * @param after The surname the student was added after, or NULL.
+ * @param student The student data of the record, or NULL.
+ * @return void
+ */
+static void journalWrite(stud_List *list, char op, const char *after, const stud *student) 
+{
+    Journal *journal = list->journal;
+    if (journal == NULL || journal->file == NULL) return;
+
+    fputc(op, journal->file);
+    if (after != NULL) 
+    {
+        fprintf(journal->file, " %s", after);
+    }
+    if (student != NULL) 
+    {
+        fprintf(journal->file, " %s %s %s %d %d",
+                student->surname, student->name, student->patronymic, student->age, student->average_score);
+    }
+    fputc('\n', journal->file);
+    fflush(journal->file);
+
+    journal->records++;
+
+    // Compaction keeps replay time proportional to the list size
+    size_t threshold = list->size / 4;
+    if (threshold < JOURNAL_MIN_COMPACT_RECORDS) threshold = JOURNAL_MIN_COMPACT_RECORDS;
+
+    if (journal->records >= threshold) 
+    {
+        journalCompactInBackground(list);
+    }
+}
+
+/**
+ * @brief Copies the data fields of a student, leaving links and pool bookkeeping alone.
+ * @param to The record to fill.
+ * @param from The student data.
+ * @return void
+ */
+static void copyStudentData(stud *to, const stud *from) 
+{
+    memcpy(to->surname, from->surname, sizeof(to->surname));
+    memcpy(to->name, from->name, sizeof(to->name));
+    memcpy(to->patronymic, from->patronymic, sizeof(to->patronymic));
+    to->age = from->age;
+    to->average_score = from->average_score;
+}
+
+stud *pushStudBeg(stud_List *list, const stud *data) 
+{
+    METRICS_START(started);
+
+    // Allocate memory for the new node
+    stud* new_node = allocStudNear(list, list->head);
+    
+    if (new_node == NULL) 
+	{
+        // If memory is not allocated, display an error message
+    	printf("Error allocating memory\n");
+        return NULL;
+	}
+    copyStudentData(new_node, data);
+
+    // Add the node to the beginning of the list
+    new_node->next = list->head;
+    new_node->prev = NULL;
+    
+    if (list->head != NULL) 
+	{ 
+        // If the list is not empty, update the pointer to the previous element of the old head
+        list->head->prev = new_node; 
+    } 
+    
+    else
+    {
+        // If the list was empty, set the new node as the tail
+    	list->tail = new_node;
+	}
+    
+    list->head = new_node;
+    indexStudent(list, new_node);
+
+    // Increase the size of the list
+    list->size++;
+
+    journalWrite(list, 'B', NULL, new_node);
+    METRICS_RECORD(METRIC_ADD, started, 1, 0);
+    return new_node;
+}
+
+stud *pushStudEnd(stud_List *list, const stud *data) 
+{
+    METRICS_START(started);
+
+    // Allocate memory for the new node
+    stud *new_node = allocStudNear(list, list->tail);
+    if (new_node == NULL) 
+	{
+        printf("Error allocating memory\n");
+        return NULL;
+    }
+    copyStudentData(new_node, data);
+    
+    // Set next for the new node as NULL, since it will be the last one
+    new_node->next = NULL;  
+    
+    if (list->head == NULL) 
+	{
+        // If the list is empty, set the new node as the head and tail of the list
+        list->head = new_node; 
+        list->tail = new_node;
+        new_node->prev = NULL;  
+    } 
+    
+    else 
+    {
+        // Otherwise, add a new node to the end of the list
+        list->tail->next = new_node; 
+        new_node->prev = list->tail; 
+        list->tail = new_node;       
+    }
+    indexStudent(list, new_node);
+
+    // Increase the size of the list
+    list->size++;  
+
+    journalWrite(list, 'E', NULL, new_node);
+    METRICS_RECORD(METRIC_ADD, started, 1, 0);
+    return new_node;
+}
+
+void removeStudent(stud_List *list, stud *student) 
+{
+    // Unlink the node from its neighbours
+    if (student->prev) 
+    {
+        student->prev->next = student->next;
+    } else {
+        list->head = student->next;
+    }
+    
+    if (student->next) 
+    {
+        student->next->prev = student->prev;
+    } else {
+        list->tail = student->prev;
+    }
+
+    unindexStudent(list, student);
+    list->size--;
+
+    journalWrite(list, 'D', NULL, student);
+    freeStud(list, student);
+}
+
+/**
+ * @brief Allocates a student record from a pool.
+ * @param pool A pointer to the pool.
+ * @return A pointer to the uninitialized record, or NULL if memory allocation failed.
+ */
+static stud *poolAlloc(StudPool *pool) 
+{
+    // Reuse a released record first
+    if (pool->freeList != NULL) 
+    {
+        stud *student = pool->freeList;
+        pool->freeList = student->next;
+        return student;
+    }
+
+    StudBlock *block = pool->blocks;
+    if (block == NULL || block->used == block->capacity) 
+    {
+        // Every new block is twice as large as the previous one
+        size_t capacity = block ? block->capacity * 2 : STUD_POOL_FIRST_BLOCK;
+        if (capacity > STUD_POOL_MAX_BLOCK) capacity = STUD_POOL_MAX_BLOCK;
+
+        size_t bytes = sizeof(StudBlock) + capacity * sizeof(stud);
+        block = malloc(bytes);
+        if (block == NULL) return NULL;
+
+        block->next = pool->blocks;
+        block->used = 0;
+        block->capacity = capacity;
+        pool->blocks = block;
+        pool->bytes += bytes;
+    }
+
+    block->records[block->used].slot = (uint32_t)block->used;
+    return &block->records[block->used++];
+}
+
+stud *allocStud(stud_List *list) 
+{
+    return poolAlloc(&list->pool);
+}
+
+/**
+ * @brief Finds the pool block holding a record.
+ * @param student The record.
+ * @return A pointer to the block.
+ */
+static StudBlock *blockOf(stud *student) 
+{
+    return (StudBlock *)((char *)(student - student->slot) - offsetof(StudBlock, records));
+}
+
+stud *allocStudNear(stud_List *list, stud *neighbour) 
+{
+    if (neighbour != NULL) 
+    {
+        StudBlock *block = blockOf(neighbour);
+        if (block->used < block->capacity) 
+        {
+            block->records[block->used].slot = (uint32_t)block->used;
+            return &block->records[block->used++];
+        }
+    }
+    return poolAlloc(&list->pool);
+}
+
+void freeStud(stud_List *list, stud *student) 
+{
+    // Released records are kept on a free list linked through next
+    student->next = list->pool.freeList;
+    list->pool.freeList = student;
+}
+
+/**
+ * @brief Packs the start of a string into big-endian words, zero padded.
+ * @param text The string.
+ * @param words The words to fill.
+ * @param count The number of words.
+ * @return void
+ */
+static void packKeyWords(const char *text, uint64_t *words, size_t count) 
+{
+    for (size_t w = 0; w < count; w++) 
+    {
+        uint64_t word = 0;
+        for (int b = 0; b < 8; b++) 
+        {
+            word <<= 8;
+            if (*text) word |= (unsigned char)*text++;
+        }
+        words[w] = word;
+    }
+}
+
+/**
+ * @brief Builds the sort key of a surname and name.
+ * @param key The key to fill.
+ * @param surname The surname.
+ * @param name The name, or an empty string.
+ * @return void
+ */
+static void makeStudKey(StudKey *key, const char *surname, const char *name) 
+{
+    packKeyWords(surname, key->surname, 2);
+    packKeyWords(name, &key->name, 1);
+}
+
+/**
+ * @brief Recomputes the sort key of a student from its surname and name.
+ * @param student The student.
+ * @return void
+ */
+static void setStudentKey(stud *student) 
+{
+    makeStudKey(&student->key, student->surname, student->name);
+}
+
+/**
+ * @brief Compares the surname of a student with a surname and its key.
+ * @param student The student, with an up-to-date key.
+ * @param key The key of the other surname.
+ * @param surname The other surname.
+ * @return A negative value, zero or a positive value, like strcmp.
+ */
+static int compareSurnameKey(const stud *student, const StudKey *key, const char *surname) 
+{
+    if (student->key.surname[0] != key->surname[0]) return student->key.surname[0] < key->surname[0] ? -1 : 1;
+    if (student->key.surname[1] != key->surname[1]) return student->key.surname[1] < key->surname[1] ? -1 : 1;
+
+    // Equal packed surnames ending within the key are equal surnames
+    if ((key->surname[1] & 0xFF) == 0) return 0;
+    return strcmp(student->surname + 16, surname + 16);
+}
+
+/**
+ * @brief Tells whether a student has a given name.
+ * @param student The student, with an up-to-date key.
+ * @param nameWord The packed name.
+ * @param name The name.
+ * @return Non-zero if the names are equal.
+ */
+static int sameNameKey(const stud *student, uint64_t nameWord, const char *name) 
+{
+    if (student->key.name != nameWord) return 0;
+    return (nameWord & 0xFF) == 0 || strcmp(student->name + 8, name + 8) == 0;
+}
+
+int compareStudents(const stud *a, const stud *b) 
+{
+    // Compare the packed surnames and names first; the strings are needed
+    // only for ties on long surnames or names
+    int result = compareSurnameKey(a, &b->key, b->surname);
+    if (result != 0) return result;
+
+    if (a->key.name != b->key.name) return a->key.name < b->key.name ? -1 : 1;
+    if ((a->key.name & 0xFF) == 0) return 0;
+    return strcmp(a->name + 8, b->name + 8);
+}
+
+/**
+ * @brief Allocates a trie node.
+ * @param label The letters of the edge leading to the node.
+ * @param length The number of letters.
+ * @return A pointer to the node, without children.
+ */
+static TrieNode *trieNewNode(const char *label, size_t length) 
+{
+    TrieNode *node = malloc(sizeof(TrieNode));
+    if (node == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(node->label, label, length);
+    node->length = (unsigned char)length;
+    node->child = node->sibling = NULL;
+    node->terminal = 0;
+    return node;
+}
+
+/**
+ * @brief Adds a surname to the trie; adding it again changes nothing.
+ * @param root The root of the trie, created on the first call.
+ * @param surname The surname to add.
+ * @return void
+ */
+static void trieInsert(TrieNode **root, const char *surname) 
+{
+    if (*root == NULL) *root = trieNewNode("", 0);
+
+    TrieNode *node = *root;
+    const char *rest = surname;
+
+    while (*rest != '\0') 
+    {
+        // Find the child starting with the next letter, or where it belongs
+        TrieNode **link = &node->child;
+        while (*link != NULL && (unsigned char)(*link)->label[0] < (unsigned char)*rest) 
+        {
+            link = &(*link)->sibling;
+        }
+
+        TrieNode *child = *link;
+        if (child == NULL || child->label[0] != *rest) 
+        {
+            TrieNode *leaf = trieNewNode(rest, strlen(rest));
+            leaf->terminal = 1;
+            leaf->sibling = child;
+            *link = leaf;
+            return;
+        }
+
+        size_t common = 1;
+        while (common < child->length && child->label[common] == rest[common]) common++;
+
+        if (common < child->length) 
+        {
+            // The surname leaves the edge half way: split it
+            TrieNode *middle = trieNewNode(child->label, common);
+            middle->child = child;
+            middle->sibling = child->sibling;
+            child->sibling = NULL;
+            child->length -= (unsigned char)common;
+            memmove(child->label, child->label + common, child->length);
+            *link = middle;
+            child = middle;
+        }
+
+        node = child;
+        rest += common;
+    }
+
+    node->terminal = 1;
+}
+
+/**
+ * @brief Removes a surname from the trie and merges the edges it leaves behind.
+ * @param root The root of the trie.
+ * @param surname The surname to remove.
+ * @return void
+ */
+static void trieRemove(TrieNode **root, const char *surname) 
+{
+    if (*root == NULL) return;
+
+    // A surname has at most one node per letter
+    TrieNode **path[20];
+    int depth = 0;
+
+    TrieNode **link = root;
+    const char *rest = surname;
+
+    while (*rest != '\0') 
+    {
+        TrieNode **next = &(*link)->child;
+        while (*next != NULL && (*next)->label[0] != *rest) next = &(*next)->sibling;
+
+        TrieNode *child = *next;
+        if (child == NULL || strncmp(child->label, rest, child->length) != 0) return;
+
+        path[depth++] = link;
+        link = next;
+        rest += child->length;
+    }
+
+    TrieNode *node = *link;
+    if (!node->terminal) return;
+    node->terminal = 0;
+
+    if (depth == 0) return;
+
+    if (node->child == NULL) 
+    {
+        // A leaf goes away, which may leave its parent with a single child
+        *link = node->sibling;
+        free(node);
+
+        link = path[depth - 1];
+        node = *link;
+        if (depth == 1 || node->terminal || node->child == NULL || node->child->sibling != NULL) return;
+    } 
+    
+    else if (node->child->sibling != NULL) 
+    {
+        return;
+    }
+
+    // Fold the only child into the node
+    TrieNode *child = node->child;
+    memcpy(node->label + node->length, child->label, child->length);
+    node->length += child->length;
+    node->terminal = child->terminal;
+    node->child = child->child;
+    free(child);
+}
+
+/**
+ * @brief Frees a trie.
+ * @param node The root of the trie, may be NULL.
+ * @return void
+ */
+static void trieFree(TrieNode *node) 
+{
+    while (node != NULL) 
+    {
+        TrieNode *sibling = node->sibling;
+        trieFree(node->child);
+        free(node);
+        node = sibling;
+    }
+}
+
+/**
+ * @brief Hashes a surname from its packed key.
+ * @param key The key of the surname.
+ * @param surname The surname, whose letters past the key are hashed as well.
+ * @return The 64-bit hash value.
+ */
+static uint64_t hashSurname(const StudKey *key, const char *surname) 
+{
+    // Mix the packed words with the splitmix64 finalizer
+    uint64_t hash = key->surname[0];
+    for (int w = 0; w < 2; w++) 
+    {
+        if (w > 0) hash ^= key->surname[1];
+        hash ^= hash >> 30;
+        hash *= 0xBF58476D1CE4E5B9ULL;
+        hash ^= hash >> 27;
+        hash *= 0x94D049BB133111EBULL;
+        hash ^= hash >> 31;
+    }
+
+    // Long surnames add the rest of their letters with FNV-1a
+    if ((key->surname[1] & 0xFF) != 0) 
+    {
+        for (const char *c = surname + 16; *c; c++) 
+        {
+            hash ^= (unsigned char)*c;
+            hash *= 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+/**
+ * @brief Finds the slot for a surname, or the empty slot where it would go.
+ * @param index A pointer to the surname index with a non-zero capacity.
+ * @param key The key of the surname.
+ * @param surname The surname to look up.
+ * @param hash The hash of the surname.
+ * @return A pointer to the matching or empty slot.
+ */
+static SurnameSlot *probeSurnameSlot(SurnameIndex *index, const StudKey *key, const char *surname, uint64_t hash) 
+{
+    size_t mask = index->capacity - 1;
+    size_t i = (size_t)hash & mask;
+
+    // Linear probing until the surname or an empty slot is found
+    while (index->slots[i].first != NULL) 
+    {
+        if (index->slots[i].hash == hash && compareSurnameKey(index->slots[i].first, key, surname) == 0) 
+        {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+
+    return &index->slots[i];
+}
+
+/**
+ * @brief Doubles the capacity of the surname index and reinserts all chains.
+ * @param index A pointer to the surname index.
+ * @return void
+ */
+static void growSurnameIndex(SurnameIndex *index) 
+{
+    SurnameSlot *old = index->slots;
+    size_t oldCapacity = index->capacity;
+
+    index->capacity = oldCapacity ? oldCapacity * 2 : 16;
+    index->slots = calloc(index->capacity, sizeof(SurnameSlot));
+
+    if (index->slots == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Move every chain to its new slot, chains themselves are not touched
+    for (size_t i = 0; i < oldCapacity; i++) 
+    {
+        if (old[i].first != NULL) 
+        {
+            *probeSurnameSlot(index, &old[i].first->key, old[i].first->surname, old[i].hash) = old[i];
+        }
+    }
+
+    free(old);
+}
+
+SurnameSlot *findSurnameSlot(stud_List *list, const char *surname) 
+{
+    if (list == NULL || list->index.used == 0) return NULL;
+
+    StudKey key;
+    makeStudKey(&key, surname, "");
+
+    SurnameSlot *slot = probeSurnameSlot(&list->index, &key, surname, hashSurname(&key, surname));
+    return slot->first ? slot : NULL;
+}
+
+/**
+ * @brief Adds a student to the surname index.
+ * @param list A pointer to the student list.
+ * @param student The student, already linked into the list.
+ * @param append Non-zero to append to the chain without looking at the list order.
+ * @return void
+ */
+static void indexStudentAt(stud_List *list, stud *student, int append) 
+{
+    SurnameIndex *index = &list->index;
+
+    // Keep the load factor at or below one half
+    if ((index->used + 1) * 2 > index->capacity) 
+    {
+        growSurnameIndex(index);
+    }
+
+    // Every student added to the list passes here, so this keeps the key current
+    setStudentKey(student);
+
+    uint64_t hash = hashSurname(&student->key, student->surname);
+    SurnameSlot *slot = probeSurnameSlot(index, &student->key, student->surname, hash);
+
+    if (slot->first == NULL) 
+    {
+        // First student with this surname
+        slot->hash = hash;
+        slot->first = slot->last = student;
+        slot->count = 1;
+        student->prevSame = student->nextSame = NULL;
+        index->used++;
+
+        trieInsert(&list->trie, student->surname);
+        return;
+    }
+
+    // Place the student next to a list neighbour with the same surname, or at
+    // the matching end of the chain at an end of the list. Only the neighbours
+    // are looked at, so this takes constant time
+    stud *after = NULL;
+    if (append || student->next == NULL) 
+    {
+        after = slot->last;
+    } 
+    else if (student->prev == NULL) 
+    {
+        after = NULL;
+    } 
+    else if (compareSurnameKey(student->prev, &student->key, student->surname) == 0 &&
+             (student->prev->prevSame != NULL || slot->first == student->prev)) 
+    {
+        after = student->prev;
+    } 
+    else if (compareSurnameKey(student->next, &student->key, student->surname) == 0 &&
+             (student->next->prevSame != NULL || slot->first == student->next)) 
+    {
+        after = student->next->prevSame;
+    } 
+    else 
+    {
+        // The others with this surname are elsewhere in the list; where exactly
+        // would take a walk, so the student is appended until the next sort
+        after = slot->last;
+        index->stale = 1;
+    }
+
+    student->prevSame = after;
+    student->nextSame = after ? after->nextSame : slot->first;
+
+    if (student->prevSame) student->prevSame->nextSame = student;
+    else slot->first = student;
+
+    if (student->nextSame) student->nextSame->prevSame = student;
+    else slot->last = student;
+
+    slot->count++;
+}
+
+/**
+ * @brief Reallocates one column, exiting if memory is exhausted.
+ * @param column The column array.
+ * @param size The new size in bytes.
+ * @return The reallocated column.
+ */
+static void *growColumn(void *column, size_t size) 
+{
+    void *grown = realloc(column, size);
+    if (grown == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    return grown;
+}
+
+/**
+ * @brief Makes room for the given number of rows in every column.
+ * @param columns A pointer to the columns.
+ * @param capacity The number of rows needed.
+ * @return void
+ */
+static void reserveColumns(StudColumns *columns, size_t capacity) 
+{
+    if (capacity <= columns->capacity) return;
+
+    size_t grown = columns->capacity ? columns->capacity : 64;
+    while (grown < capacity) grown *= 2;
+
+    columns->age = growColumn(columns->age, grown * sizeof(*columns->age));
+    columns->average_score = growColumn(columns->average_score, grown * sizeof(*columns->average_score));
+    columns->student = growColumn(columns->student, grown * sizeof(*columns->student));
+    columns->live = growColumn(columns->live, grown / 64 * sizeof(*columns->live));
+    columns->capacity = grown;
+}
+
+/**
+ * @brief Frees the arrays of the columns.
+ * @param columns A pointer to the columns.
+ * @return void
+ */
+static void freeColumns(StudColumns *columns) 
+{
+    free(columns->age);
+    free(columns->average_score);
+    free(columns->student);
+    free(columns->live);
+    memset(columns, 0, sizeof(*columns));
+}
+
+/**
+ * @brief Stores a student in the next row of the columns.
+ * @param columns A pointer to the columns, with room for the row.
+ * @param student The student.
+ * @return void
+ */
+static void columnsAppend(StudColumns *columns, stud *student) 
+{
+    size_t row = columns->count++;
+
+    // A new bitmap word starts out empty
+    if (row % 64 == 0) columns->live[row / 64] = 0;
+
+    columns->age[row] = student->age;
+    columns->average_score[row] = student->average_score;
+    columns->student[row] = student;
+    columns->live[row / 64] |= (uint64_t)1 << (row % 64);
+    student->row = (uint32_t)row;
+}
+
+/**
+ * @brief Keeps the columns in step with a student just added to the list.
+ * A student added at the end takes the next row; anywhere else it changes the
+ * order of the rows, which are then laid out again before the next scan.
+ * @param list A pointer to the student list.
+ * @param student The student, already linked into the list.
+ * @return void
+ */
+static void columnsAddStudent(stud_List *list, stud *student) 
+{
+    StudColumns *columns = &list->columns;
+    if (!columns->current) return;
+
+    if (student->next != NULL) 
+    {
+        columns->current = 0;
+        return;
+    }
+
+    reserveColumns(columns, columns->count + 1);
+    columnsAppend(columns, student);
+}
+
+/**
+ * @brief Keeps the columns in step with a student about to leave the list.
+ * Its row stays behind as a dead row until the rows are laid out again.
+ * @param list A pointer to the student list.
+ * @param student The student.
+ * @return void
+ */
+static void columnsRemoveStudent(stud_List *list, stud *student) 
+{
+    StudColumns *columns = &list->columns;
+    if (!columns->current) return;
+
+    columns->live[student->row / 64] &= ~((uint64_t)1 << (student->row % 64));
+    columns->student[student->row] = NULL;
+
+    // Lay the rows out again once most of them are dead
+    if (++columns->dead * 2 > columns->count) columns->current = 0;
+}
+
+#ifdef LIST_THREADS
+// Parallel readers of the server may find the columns behind the list at the
+// same time; only one lays them out again. Changes to the list never run
+// alongside readers, so they need no lock
+static pthread_mutex_t columnsLock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+void refreshColumns(stud_List *list) 
+{
+#ifdef LIST_THREADS
+    pthread_mutex_lock(&columnsLock);
+#endif
+
+    StudColumns *columns = &list->columns;
+    if (!columns->current) 
+    {
+        columns->count = 0;
+        columns->dead = 0;
+        reserveColumns(columns, list->size);
+
+        for (stud *current = list->head; current != NULL; current = current->next) 
+        {
+            columnsAppend(columns, current);
+        }
+        columns->current = 1;
+    }
+
+#ifdef LIST_THREADS
+    pthread_mutex_unlock(&columnsLock);
+#endif
+}
+
+/**
+ * @brief Removes a student from the surname index only.
+ * @param list A pointer to the student list.
+ * @param student The student to remove.
+ * @return void
+ */
+static void unindexSurname(stud_List *list, stud *student) 
+{
+    SurnameIndex *index = &list->index;
+    SurnameSlot *slot = findSurnameSlot(list, student->surname);
+    if (slot == NULL) return;
+
+    // Unlink the student from its chain
+    if (student->prevSame) student->prevSame->nextSame = student->nextSame;
+    else slot->first = student->nextSame;
+
+    if (student->nextSame) student->nextSame->prevSame = student->prevSame;
+    else slot->last = student->prevSame;
+
+    student->prevSame = student->nextSame = NULL;
+    slot->count--;
+
+    if (slot->count > 0) return;
+
+    // The chain is empty: remove the slot and shift back the following
+    // entries of the probe sequence so that lookups still find them
+    size_t mask = index->capacity - 1;
+    size_t hole = (size_t)(slot - index->slots);
+    size_t i = hole;
+
+    index->slots[hole].first = index->slots[hole].last = NULL;
+    index->used--;
+
+    trieRemove(&list->trie, student->surname);
+
+    for (;;) 
+    {
+        i = (i + 1) & mask;
+        if (index->slots[i].first == NULL) break;
+
+        size_t home = (size_t)index->slots[i].hash & mask;
+
+        // Move the entry into the hole unless its home lies between the hole and it
+        if (((i - home) & mask) >= ((i - hole) & mask)) 
+        {
+            index->slots[hole] = index->slots[i];
+            index->slots[i].first = index->slots[i].last = NULL;
+            hole = i;
+        }
+    }
+}
+
+/**
+ * @brief Adds a whole chain of students with one new surname to the surname index.
+ * @param list A pointer to the student list.
+ * @param first The first student of the chain, already linked through nextSame.
+ * @param last The last student of the chain.
+ * @param count The number of students in the chain.
+ * @return void
+ */
+static void indexSurnameChain(stud_List *list, stud *first, stud *last, size_t count) 
+{
+    SurnameIndex *index = &list->index;
+
+    if ((index->used + 1) * 2 > index->capacity) 
+    {
+        growSurnameIndex(index);
+    }
+
+    uint64_t hash = hashSurname(&first->key, first->surname);
+    SurnameSlot *slot = probeSurnameSlot(index, &first->key, first->surname, hash);
+
+    slot->hash = hash;
+    slot->first = first;
+    slot->last = last;
+    slot->count = count;
+    index->used++;
+
+    trieInsert(&list->trie, first->surname);
+}
+
+void rebuildSurnameIndex(stud_List *list) 
+{
+    if (list->index.slots != NULL) 
+    {
+        memset(list->index.slots, 0, list->index.capacity * sizeof(SurnameSlot));
+    }
+    list->index.used = 0;
+
+    stud *current;
+    for (current = list->head; current != NULL; current = current->next) 
+    {
+        current->prevSame = current->nextSame = NULL;
+    }
+
+    // Appending in list order makes every chain follow the list order
+    for (current = list->head; current != NULL; current = current->next) 
+    {
+        indexStudentAt(list, current, 1);
+    }
+    list->index.stale = 0;
+}
+
+/**
+ * @brief Draws the level of a new ordered index node.
+ * @param seed The non-zero state of the random generator, advanced by one step.
+ * @return A level from 1 to ORDER_MAX_LEVEL.
+ */
+static int orderRandomLevel(uint32_t *seed) 
+{
+    // xorshift32 gives sixteen two-bit draws per step
+    uint32_t x = *seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+
+    int level = 1;
+    while (level < ORDER_MAX_LEVEL && (x & 3) == 0) 
+    {
+        level++;
+        x >>= 2;
+    }
+    return level;
+}
+
+/**
+ * @brief Allocates an ordered index node.
+ * @param student The student of the node, NULL for the head.
+ * @param level The number of levels of the node.
+ * @return A pointer to the node with all links cleared.
+ */
+static OrderNode *orderNewNode(stud *student, int level) 
+{
+    OrderNode *node = malloc(sizeof(OrderNode) + (size_t)level * sizeof(OrderNode *));
+    if (node == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    node->student = student;
+    node->prev = NULL;
+    node->level = level;
+    for (int i = 0; i < level; i++) node->next[i] = NULL;
+    return node;
+}
+
+// Where a student goes among the students with the same surname and name
+typedef enum 
+{
+    ORDER_FIRST,
+    ORDER_LAST,
+    ORDER_AFTER
+    
+} OrderTie;
+
+/**
+ * @brief Links a student into the ordered index.
+ * @param list A pointer to the student list.
+ * @param student The student to add.
+ * @param tie The place among equal students.
+ * @param after The equal student to follow for ORDER_AFTER.
+ * @return A pointer to the new node.
+ */
+static OrderNode *orderInsert(stud_List *list, stud *student, OrderTie tie, stud *after) 
+{
+    OrderIndex *order = &list->order;
+    OrderNode *update[ORDER_MAX_LEVEL];
+
+    if (order->head == NULL) 
+    {
+        order->head = orderNewNode(NULL, ORDER_MAX_LEVEL);
+        for (int i = 0; i < ORDER_MAX_LEVEL; i++) order->last[i] = order->head;
+    }
+
+    int level = orderRandomLevel(&order->seed);
+    for (int i = order->level; i < level; i++) update[i] = order->head;
+    int top = level < order->level ? level : order->level;
+
+    if (tie == ORDER_AFTER) 
+    {
+        // The predecessor on each level is the nearest node at or before the
+        // equal student that is tall enough; walk back to it
+        OrderNode *current = after->orderNode;
+        for (int i = 0; i < top; i++) 
+        {
+            while (current->level <= i) current = current->prev;
+            update[i] = current;
+        }
+    } 
+    
+    else if (tie == ORDER_LAST && 
+             (order->last[0] == order->head || compareStudents(order->last[0]->student, student) <= 0)) 
+    {
+        // Appending in order, as when loading a sorted file
+        for (int i = 0; i < top; i++) update[i] = order->last[i];
+    } 
+    
+    else 
+    {
+        // Descend from the top level; the bound decides the place among equal keys
+        int bound = tie == ORDER_FIRST ? 0 : 1;
+        OrderNode *current = order->head;
+        for (int i = order->level - 1; i >= 0; i--) 
+        {
+            while (current->next[i] != NULL && compareStudents(current->next[i]->student, student) < bound) 
+            {
+                current = current->next[i];
+            }
+            if (i < level) update[i] = current;
+        }
+    }
+
+    OrderNode *node = orderNewNode(student, level);
+    for (int i = 0; i < level; i++) 
+    {
+        node->next[i] = update[i]->next[i];
+        update[i]->next[i] = node;
+        if (node->next[i] == NULL) order->last[i] = node;
+    }
+
+    node->prev = update[0];
+    if (node->next[0] != NULL) node->next[0]->prev = node;
+
+    if (level > order->level) order->level = level;
+    student->orderNode = node;
+    return node;
+}
+
+/**
+ * @brief Unlinks a student from the ordered index and frees its node.
+ * @param list A pointer to the student list.
+ * @param student The student to remove.
+ * @return void
+ */
+static void orderRemove(stud_List *list, stud *student) 
+{
+    OrderIndex *order = &list->order;
+    OrderNode *node = student->orderNode;
+    if (node == NULL) return;
+
+    // Equal keys make a search ambiguous, so walk back to the predecessors instead
+    OrderNode *current = node->prev;
+    for (int i = 0; i < node->level; i++) 
+    {
+        while (current->level <= i) current = current->prev;
+
+        current->next[i] = node->next[i];
+        if (node->next[i] == NULL) order->last[i] = current;
+    }
+
+    if (node->next[0] != NULL) node->next[0]->prev = node->prev;
+
+    while (order->level > 1 && order->head->next[order->level - 1] == NULL) 
+    {
+        order->level--;
+    }
+
+    student->orderNode = NULL;
+    free(node);
+}
+
+/**
+ * @brief Drops every node of the ordered index but the head.
+ * @param order A pointer to the ordered index.
+ * @return void
+ */
+static void orderClear(OrderIndex *order) 
+{
+    if (order->head == NULL) return;
+
+    OrderNode *node = order->head->next[0];
+    while (node != NULL) 
+    {
+        OrderNode *next = node->next[0];
+        free(node);
+        node = next;
+    }
+
+    for (int i = 0; i < ORDER_MAX_LEVEL; i++) 
+    {
+        order->head->next[i] = NULL;
+        order->last[i] = order->head;
+    }
+    order->level = 1;
+}
+
+/**
+ * @brief Adds a student to the score index after the students with the same score.
+ * @param list A pointer to the student list.
+ * @param student The student to add.
+ * @return void
+ */
+static void scoreIndexAdd(stud_List *list, stud *student) 
+{
+    student->scoreEntry = bstInsert(&list->scores, student->average_score, student);
+}
+
+/**
+ * @brief Removes a student from the score index.
+ * @param list A pointer to the student list.
+ * @param student The student to remove.
+ * @return void
+ */
+static void scoreIndexRemove(stud_List *list, stud *student) 
+{
+    if (student->scoreEntry == NULL) return;
+
+    bstRemove(&list->scores, student->scoreEntry);
+    student->scoreEntry = NULL;
+}
+
+/**
+ * @brief Rebuilds the score index from the list, so equal scores follow the list order.
+ * @param list A pointer to the student list.
+ * @return void
+ */
+static void buildScoreIndex(stud_List *list) 
+{
+    bstClear(&list->scores);
+
+    for (stud *current = list->head; current != NULL; current = current->next) 
+    {
+        scoreIndexAdd(list, current);
+    }
+}
+
+/**
+ * @brief Changes the score of a student in the list and in its indexes.
+ * @param list A pointer to the student list.
+ * @param student The student.
+ * @param score The new score.
+ * @return void
+ */
+static void setStudentScore(stud_List *list, stud *student, int score) 
+{
+    scoreIndexRemove(list, student);
+    student->average_score = score;
+    scoreIndexAdd(list, student);
+
+    if (list->columns.current) list->columns.average_score[student->row] = score;
+}
+
+/**
+ * @brief Sorts an array of students by surname and name with a stable bottom-up merge sort.
+ * @param items The students to sort.
+ * @param buffer Scratch space for as many students.
+ * @param count The number of students.
+ * @return void
+ */
+static void sortStudArray(stud **items, stud **buffer, size_t count) 
+{
+    stud **from = items;
+    stud **to = buffer;
+
+    for (size_t width = 1; width < count; width *= 2) 
+    {
+        for (size_t left = 0; left < count; left += 2 * width) 
+        {
+            size_t middle = left + width < count ? left + width : count;
+            size_t right = left + 2 * width < count ? left + 2 * width : count;
+            size_t i = left, j = middle, k = left;
+
+            // Taking from the left run on ties keeps the sort stable
+            while (i < middle && j < right) 
+            {
+                to[k++] = compareStudents(from[i], from[j]) <= 0 ? from[i++] : from[j++];
+            }
+            while (i < middle) to[k++] = from[i++];
+            while (j < right) to[k++] = from[j++];
+        }
+
+        stud **swap = from;
+        from = to;
+        to = swap;
+    }
+
+    if (from != items) memcpy(items, from, count * sizeof(stud *));
+}
+
+/**
+ * @brief Rebuilds the ordered index from the list.
+ * Students are sorted once with a stable merge sort over an array and appended
+ * in order, which is much faster than inserting an unsorted file one by one.
+ * @param list A pointer to the student list.
+ * @return void
+ */
+static void buildOrderIndex(stud_List *list) 
+{
+    OrderIndex *order = &list->order;
+    if (list->size == 0) return;
+
+    orderClear(order);
+
+    stud **sorted = malloc(list->size * sizeof(stud *));
+    stud **buffer = malloc(list->size * sizeof(stud *));
+    if (sorted == NULL || buffer == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t count = 0;
+    size_t descents = 0;
+    for (stud *current = list->head; current != NULL; current = current->next) 
+    {
+        if (count > 0 && compareStudents(sorted[count - 1], current) > 0) descents++;
+        sorted[count++] = current;
+    }
+
+    // Skipped for a file saved in order
+    if (descents > 0) sortStudArray(sorted, buffer, count);
+
+    order->sorted = 1;
+    order->displaced = NULL;
+
+    stud *current = list->head;
+    for (size_t i = 0; i < count; i++, current = current->next) 
+    {
+        if (sorted[i] != current) order->sorted = 0;
+        orderInsert(list, sorted[i], ORDER_LAST, NULL);
+    }
+
+    free(sorted);
+    free(buffer);
+}
+
+void indexStudent(stud_List *list, stud *student) 
+{
+    OrderIndex *order = &list->order;
+
+    indexStudentAt(list, student, 0);
+    scoreIndexAdd(list, student);
+    columnsAddStudent(list, student);
+
+    // A student before or after all others in the list goes first or last among
+    // its equals; otherwise it follows the nearest equal student before it
+    OrderTie tie = ORDER_FIRST;
+    stud *after = NULL;
+
+    if (student->next == NULL) 
+    {
+        tie = ORDER_LAST;
+    } 
+    
+    else if (student->prev != NULL) 
+    {
+        for (after = student->prevSame; after != NULL; after = after->prevSame) 
+        {
+            if (sameNameKey(after, student->key.name, student->name)) break;
+        }
+        if (after != NULL) tie = ORDER_AFTER;
+    }
+
+    OrderNode *node = orderInsert(list, student, tie, after);
+
+    // The list stays sorted if the student landed next to its predecessor in the index
+    stud *before = node->prev == order->head ? NULL : node->prev->student;
+    if (order->sorted && student->prev != before) 
+    {
+        order->sorted = 0;
+        order->displaced = student;
+    } 
+    
+    else if (!order->sorted) 
+    {
+        order->displaced = NULL;
+    }
+}
+
+void unindexStudent(stud_List *list, stud *student) 
+{
+    OrderIndex *order = &list->order;
+
+    unindexSurname(list, student);
+    orderRemove(list, student);
+    scoreIndexRemove(list, student);
+    columnsRemoveStudent(list, student);
+
+    // Without its only displaced student the list follows the index again
+    if (order->displaced == student) 
+    {
+        order->sorted = 1;
+        order->displaced = NULL;
+    }
+}
+
+stud *findFirstInOrder(stud_List *list, const char *surname) 
+{
+    OrderIndex *order = &list->order;
+    if (order->head == NULL) return NULL;
+
+    StudKey key;
+    makeStudKey(&key, surname, "");
+
+    OrderNode *current = order->head;
+    for (int i = order->level - 1; i >= 0; i--) 
+    {
+        while (current->next[i] != NULL && compareSurnameKey(current->next[i]->student, &key, surname) < 0) 
+        {
+            current = current->next[i];
+        }
+    }
+
+    return current->next[0] ? current->next[0]->student : NULL;
+}
+
+stud *nextInOrder(const stud *student) 
+{
+    OrderNode *next = student->orderNode->next[0];
+    return next ? next->student : NULL;
+}
+
+size_t printStudentsInRange(stud_List *list, const char *from, const char *to, OutBuf *out) 
+{
+    size_t length = strlen(to);
+    size_t count = 0;
+
+    for (stud *current = findFirstInOrder(list, from); current != NULL; current = nextInOrder(current)) 
+    {
+        // Surnames are visited in order, so the first one past the end stops the scan
+        if (strncmp(current->surname, to, length) > 0) break;
+
+        outStudentRow(out, current);
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Visits every surname in a trie subtree.
+ * @param node The subtree.
+ * @param word The letters leading to the node; the labels below are appended to it.
+ * @param length The number of letters in word.
+ * @param visitor Called for every surname.
+ * @param context Passed to the visitor.
+ * @return The number of surnames visited.
+ */
+static size_t trieVisitAll(const TrieNode *node, char *word, size_t length, SurnameVisitor visitor, void *context) 
+{
+    size_t count = 0;
+
+    if (node->terminal) 
+    {
+        word[length] = '\0';
+        visitor(word, 0, context);
+        count++;
+    }
+
+    for (const TrieNode *child = node->child; child != NULL; child = child->sibling) 
+    {
+        memcpy(word + length, child->label, child->length);
+        count += trieVisitAll(child, word, length + child->length, visitor, context);
+    }
+    return count;
+}
+
+size_t visitSurnamesByPrefix(stud_List *list, const char *prefix, SurnameVisitor visitor, void *context) 
+{
+    if (list->trie == NULL) return 0;
+
+    char word[20];
+    size_t length = 0;
+    const TrieNode *node = list->trie;
+    const char *rest = prefix;
+
+    // Follow the prefix down; it may end in the middle of an edge
+    while (*rest != '\0') 
+    {
+        const TrieNode *child = node->child;
+        while (child != NULL && child->label[0] != *rest) child = child->sibling;
+        if (child == NULL) return 0;
+
+        size_t i = 0;
+        while (i < child->length && rest[i] != '\0') 
+        {
+            if (child->label[i] != rest[i]) return 0;
+            i++;
+        }
+
+        memcpy(word + length, child->label, child->length);
+        length += child->length;
+        rest += i;
+        node = child;
+    }
+
+    return trieVisitAll(node, word, length, visitor, context);
+}
+
+/**
+ * @brief Visits the surnames of a trie subtree within an edit distance of a query.
+ * @param node The subtree.
+ * @param query The query.
+ * @param queryLength The length of the query.
+ * @param row The edit distances between the query prefixes and the letters above the node.
+ * @param maxDistance The largest distance accepted.
+ * @param word The letters leading to the node.
+ * @param length The number of letters in word.
+ * @param visitor Called for every surname found.
+ * @param context Passed to the visitor.
+ * @return The number of surnames visited.
+ */
+static size_t trieVisitSimilar(const TrieNode *node, const char *query, size_t queryLength, const int *row, int maxDistance, 
+                               char *word, size_t length, SurnameVisitor visitor, void *context) 
+{
+    size_t count = 0;
+
+    for (const TrieNode *child = node->child; child != NULL; child = child->sibling) 
+    {
+        int rows[2][21];
+        const int *previous = row;
+        int *current = NULL;
+        int reachable = 1;
+
+        // One row of the Levenshtein table per letter of the edge
+        for (size_t k = 0; k < child->length; k++) 
+        {
+            current = rows[k % 2];
+            current[0] = previous[0] + 1;
+            int best = current[0];
+
+            for (size_t j = 1; j <= queryLength; j++) 
+            {
+                int cost = query[j - 1] == child->label[k] ? 0 : 1;
+                int value = previous[j - 1] + cost;
+                if (previous[j] + 1 < value) value = previous[j] + 1;
+                if (current[j - 1] + 1 < value) value = current[j - 1] + 1;
+                current[j] = value;
+                if (value < best) best = value;
+            }
+
+            word[length + k] = child->label[k];
+            previous = current;
+
+            // Every longer word is at least this far away
+            if (best > maxDistance) 
+            {
+                reachable = 0;
+                break;
+            }
+        }
+
+        if (!reachable) continue;
+
+        if (child->terminal && previous[queryLength] <= maxDistance) 
+        {
+            word[length + child->length] = '\0';
+            visitor(word, previous[queryLength], context);
+            count++;
+        }
+
+        count += trieVisitSimilar(child, query, queryLength, previous, maxDistance, 
+                                  word, length + child->length, visitor, context);
+    }
+    return count;
+}
+
+size_t visitSimilarSurnames(stud_List *list, const char *query, int maxDistance, SurnameVisitor visitor, void *context) 
+{
+    if (list->trie == NULL) return 0;
+
+    size_t queryLength = strlen(query);
+    if (queryLength > 19) queryLength = 19;
+
+    // Distances from the empty word to every query prefix
+    int row[21];
+    for (size_t j = 0; j <= queryLength; j++) row[j] = (int)j;
+
+    char word[20];
+    size_t count = 0;
+
+    if (list->trie->terminal && row[queryLength] <= maxDistance) 
+    {
+        word[0] = '\0';
+        visitor(word, row[queryLength], context);
+        count++;
+    }
+
+    return count + trieVisitSimilar(list->trie, query, queryLength, row, maxDistance, word, 0, visitor, context);
+}
+
+// State shared by the printing visitors
+typedef struct 
+{
+    stud_List *list;
+    OutBuf *out;
+    size_t students;
+    
+} SurnamePrinter;
+
+/**
+ * @brief Writes a surname and its number of students.
+ * @param surname The surname.
+ * @param distance Unused.
+ * @param context A pointer to a SurnamePrinter.
+ * @return void
+ */
+static void printSurnameCount(const char *surname, int distance, void *context) 
+{
+    SurnamePrinter *printer = context;
+    SurnameSlot *slot = findSurnameSlot(printer->list, surname);
+    size_t count = slot ? slot->count : 0;
+    (void)distance;
+
+    outPrintf(printer->out, "%-20s %zu student%s\n", surname, count, count == 1 ? "" : "s");
+    printer->students += count;
+}
+
+/**
+ * @brief Writes the students with a surname as table rows.
+ * @param surname The surname.
+ * @param distance Unused.
+ * @param context A pointer to a SurnamePrinter.
+ * @return void
+ */
+static void printSurnameStudents(const char *surname, int distance, void *context) 
+{
+    SurnamePrinter *printer = context;
+    SurnameSlot *slot = findSurnameSlot(printer->list, surname);
+    (void)distance;
+
+    for (stud *current = slot ? slot->first : NULL; current != NULL; current = current->nextSame) 
+    {
+        outStudentRow(printer->out, current);
+        printer->students++;
+    }
+}
+
+size_t printSurnameCompletions(stud_List *list, const char *prefix, OutBuf *out) 
+{
+    SurnamePrinter printer = { list, out, 0 };
+    return visitSurnamesByPrefix(list, prefix, printSurnameCount, &printer);
+}
+
+size_t printStudentsWithSimilarSurname(stud_List *list, const char *query, int maxDistance, OutBuf *out) 
+{
+    SurnamePrinter printer = { list, out, 0 };
+    visitSimilarSurnames(list, query, maxDistance, printSurnameStudents, &printer);
+    return printer.students;
+}
+
+/**
+ * @brief Follows a link to a record moved by relayoutList.
+ * @param student The old record, whose next link holds the new address, or NULL.
+ * @return The new record, or NULL.
+ */
+static stud *relocated(stud *student) 
+{
+    return student ? student->next : NULL;
+}
+
+/**
+ * @brief Moves every record into new pool blocks in list order.
+ * Walking the list then reads memory front to back. Each block is left partly
+ * empty for students added next to its records. All links into the records,
+ * from the list and the surname, ordered and score indexes, are updated. If
+ * memory runs out the records stay where they are.
+ * @param list A pointer to the student list.
+ * @return void
+ */
+static void relayoutList(stud_List *list) 
+{
+    size_t total = list->size;
+    size_t count = (total + STUD_LAYOUT_FILL - 1) / STUD_LAYOUT_FILL;
+    if (count == 0) return;
+
+    size_t bytes = sizeof(StudBlock) + STUD_LAYOUT_BLOCK * sizeof(stud);
+    StudBlock **blocks = malloc(count * sizeof(StudBlock *));
+    stud **olds = malloc(total * sizeof(stud *));
+    size_t allocated = 0;
+
+    while (blocks != NULL && olds != NULL && allocated < count) 
+    {
+        blocks[allocated] = malloc(bytes);
+        if (blocks[allocated] == NULL) break;
+        blocks[allocated]->used = 0;
+        blocks[allocated]->capacity = STUD_LAYOUT_BLOCK;
+        allocated++;
+    }
+
+    if (allocated < count) 
+    {
+        while (allocated > 0) free(blocks[--allocated]);
+        free(blocks);
+        free(olds);
+        return;
+    }
+
+    // Copy the records in list order, linking the copies to each other, and
+    // leave the new address in the next link of every old record
+    stud *previous = NULL;
+    size_t i = 0;
+    for (stud *current = list->head; current != NULL; i++) 
+    {
+        StudBlock *block = blocks[i / STUD_LAYOUT_FILL];
+        stud *copy = &block->records[block->used];
+        stud *next = current->next;
+
+        *copy = *current;
+        copy->slot = (uint32_t)block->used++;
+        copy->prev = previous;
+        if (previous) previous->next = copy;
+
+        olds[i] = current;
+        current->next = copy;
+        previous = copy;
+        current = next;
+    }
+    previous->next = NULL;
+    list->head = olds[0]->next;
+    list->tail = previous;
+
+    // Students with the same surname are mostly neighbours in the list; only
+    // the other chain links need to follow the old records
+    for (i = 0; i < total; i++) 
+    {
+        stud *student = &blocks[i / STUD_LAYOUT_FILL]->records[i % STUD_LAYOUT_FILL];
+
+        if (student->nextSame != NULL) 
+        {
+            student->nextSame = i + 1 < total && student->nextSame == olds[i + 1] ? student->next : relocated(student->nextSame);
+        }
+        if (student->prevSame != NULL) 
+        {
+            student->prevSame = i > 0 && student->prevSame == olds[i - 1] ? student->prev : relocated(student->prevSame);
+        }
+        student->orderNode->student = student;
+        student->scoreEntry->payload = student;
+        if (list->columns.current) list->columns.student[student->row] = student;
+    }
+
+    for (i = 0; i < list->index.capacity; i++) 
+    {
+        SurnameSlot *slot = &list->index.slots[i];
+        if (slot->first == NULL) continue;
+        slot->first = relocated(slot->first);
+        slot->last = relocated(slot->last);
+    }
+    list->order.displaced = relocated(list->order.displaced);
+
+    // The old blocks and their released records go; the last new block, with
+    // the end of the list, is where plain allocations continue
+    StudBlock *block = list->pool.blocks;
+    while (block != NULL) 
+    {
+        StudBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    list->pool.blocks = NULL;
+    for (i = 0; i < count; i++) 
+    {
+        blocks[i]->next = list->pool.blocks;
+        list->pool.blocks = blocks[i];
+    }
+    list->pool.freeList = NULL;
+    list->pool.bytes = count * bytes;
+    free(blocks);
+    free(olds);
+}
+
+void sortStudList(stud_List *list) 
+{
+    OrderIndex *order = &list->order;
+    METRICS_START(started);
+
+    // An empty list is sorted whatever happened before
+    if (list->head == NULL) 
+    {
+        order->sorted = 1;
+        order->displaced = NULL;
+    }
+
+    // A student inserted away from the others with its surname may also sit in
+    // the wrong place among its equals in the ordered index; index the list again
+    if (list->index.stale) 
+    {
+        buildOrderIndex(list);
+        if (order->sorted) rebuildSurnameIndex(list);
+    }
+
+    // The list already follows the index order
+    if (order->sorted) return;
+
+    // Relinking changes the order of the columnar rows
+    list->columns.current = 0;
+
+    if (order->displaced != NULL) 
+    {
+        // Only one student is out of place: move it after its predecessor in the index
+        stud *student = order->displaced;
+        OrderNode *before = student->orderNode->prev;
+        stud *after = before == order->head ? NULL : before->student;
+
+        if (student->prev) student->prev->next = student->next;
+        else list->head = student->next;
+
+        if (student->next) student->next->prev = student->prev;
+        else list->tail = student->prev;
+
+        student->prev = after;
+        student->next = after ? after->next : list->head;
+
+        if (student->prev) student->prev->next = student;
+        else list->head = student;
+
+        if (student->next) student->next->prev = student;
+        else list->tail = student;
+
+        // Its place among the students with the same surname changed as well
+        unindexSurname(list, student);
+        indexStudentAt(list, student, 0);
+    } 
+    
+    else 
+    {
+        // Relink the whole list in index order in a single pass
+        stud *prev = NULL;
+        for (OrderNode *node = order->head->next[0]; node != NULL; node = node->next[0]) 
+        {
+            node->student->prev = prev;
+            if (prev) prev->next = node->student;
+            else list->head = node->student;
+            prev = node->student;
+        }
+        prev->next = NULL;
+        list->tail = prev;
+
+        // Students with the same surname changed their relative order
+        rebuildSurnameIndex(list);
+
+        // Keep the records in memory in the new list order as well
+        relayoutList(list);
+    }
+
+    order->sorted = 1;
+    order->displaced = NULL;
+
+    journalWrite(list, 'S', NULL, NULL);
+    METRICS_RECORD(METRIC_SORT, started, list->size, 0);
+}
+
+void searchAndPrintBySurname(stud_List *list, const char *surname) 
+{
+    // Check if the list is empty
+    if (list == NULL || list->head == NULL) 
+	{
+        printf("The list is empty.\n");
+        return;
+    }
+
+    // Print table header
+    printf("\n%-20s %-10s %-20s %-10s %-10s\n", "Surname", "Name", "Patronymic", "Age", "Grade");
+    printf("-------------------------------------------------------------------------------\n");
+
+    OutBuf out;
+    outInit(&out, stdout);
+    size_t count = writeStudentsBySurname(list, surname, &out);
+    outFree(&out);
+
+    if (count == 0) 
+	{
+        printf("No student found with the surname '%s'.\n", surname);
+    }
+}
+
+size_t writeStudentsBySurname(stud_List *list, const char *surname, OutBuf *out) 
+{
+    METRICS_START(started);
+
+    // Only the chain of students with this surname is visited
+    SurnameSlot *slot = findSurnameSlot(list, surname);
+    if (slot == NULL) return 0;
+
+    // While the chains are stale only the list itself has the right order
+    size_t count = 0;
+    stud *current = list->index.stale ? list->head : slot->first;
+    for (; current != NULL; current = list->index.stale ? current->next : current->nextSame) 
+	{
+        if (strcmp(current->surname, surname) != 0) continue;
+
+        outStudentRow(out, current);
+        count++;
+    }
+
+    METRICS_RECORD(METRIC_SEARCH, started, count, 0);
+    return count;
+}
+
+int del_Nth(stud_List * list, char *surname) 
+{
+    // Check if the list is empty and if the input data is correct
+    if (list == NULL || list->head == NULL || surname == NULL) 
+    {
+        return 0;
+    }
+
+    // The index slot already knows how many students share the surname
+    SurnameSlot *slot = findSurnameSlot(list, surname);
+    if (slot == NULL) 
+    {
+        return 0;
+    }
+
+    size_t surnameCount = slot->count;
+
+    // If multiple students with the same surname are found, ask for the name
+    char name[20] = "";
+    if (surnameCount > 1) 
+    {
+        printf("There are %zu students with the surname %s. Please enter the name: ", surnameCount, surname);
+        scanf("%19s", name);
+    }
+
+    return deleteStudents(list, surname, surnameCount > 1 ? name : NULL);
+}
+
+int deleteStudents(stud_List *list, const char *surname, const char *name) 
+{
+    if (list == NULL || surname == NULL) return 0;
+    METRICS_START(started);
+
+    SurnameSlot *slot = findSurnameSlot(list, surname);
+    if (slot == NULL) return 0;
+
+    uint64_t nameWord = 0;
+    if (name != NULL) packKeyWords(name, &nameWord, 1);
+
+    int count = 0;
+    stud *current = slot->first;
+    while (current != NULL) 
+    {
+        stud *next = current->nextSame;
+        if (name == NULL || sameNameKey(current, nameWord, name)) 
+        {
+            // Delete the node
+            removeStudent(list, current);
+            count++;
+        }
+        current = next;
+    }
+
+    METRICS_RECORD(METRIC_DELETE, started, count, 0);
+    return count;
+}
+
+/**
+ * @brief Stops journaling for a batch of changes.
+ * @param list A pointer to the student list.
+ * @return The journal to hand back to batchEnd.
+ */
+static Journal *batchBegin(stud_List *list) 
+{
+    Journal *journal = list->journal;
+    list->journal = NULL;
+    return journal;
+}
+
+/**
+ * @brief Resumes journaling after a batch; the changes are saved in one snapshot.
+ * @param list A pointer to the student list.
+ * @param journal The journal returned by batchBegin.
+ * @param changes The number of changes made by the batch.
+ * @return void
+ */
+static void batchEnd(stud_List *list, Journal *journal, size_t changes) 
+{
+    list->journal = journal;
+    if (journal != NULL && changes > 0) journalCompact(list);
+}
+
+size_t deleteStudentsWhere(stud_List *list, int (*match)(const stud *student, void *context), void *context) 
+{
+    METRICS_START(started);
+    Journal *journal = batchBegin(list);
+    size_t count = 0;
+
+    stud *current = list->head;
+    while (current != NULL) 
+    {
+        stud *next = current->next;
+        if (match(current, context)) 
+        {
+            removeStudent(list, current);
+            count++;
+        }
+        current = next;
+    }
+
+    batchEnd(list, journal, count);
+    METRICS_RECORD(METRIC_DELETE, started, count, 0);
+    return count;
+}
+
+size_t deleteStudentsByKeys(stud_List *list, const DeleteKey *keys, size_t count) 
+{
+    Journal *journal = batchBegin(list);
+    size_t deleted = 0;
+
+    for (size_t i = 0; i < count; i++) 
+    {
+        deleted += (size_t)deleteStudents(list, keys[i].surname, keys[i].name[0] ? keys[i].name : NULL);
+    }
+
+    batchEnd(list, journal, deleted);
+    return deleted;
+}
+
+DeleteKey *readDeleteKeys(const char *filename, size_t *count) 
+{
+    FILE *file = fopen(filename, "r");
+    if (!file) 
+    {
+        perror("Error opening file for reading");
+        return NULL;
+    }
+
+    DeleteKey *keys = NULL;
+    size_t capacity = 0;
+    char line[128];
+    *count = 0;
+
+    while (fgets(line, sizeof(line), file)) 
+    {
+        DeleteKey key;
+        key.name[0] = '\0';
+        if (sscanf(line, "%19s %9s", key.surname, key.name) < 1) continue;
+
+        if (*count == capacity) 
+        {
+            capacity = capacity ? capacity * 2 : 1024;
+            DeleteKey *grown = realloc(keys, capacity * sizeof(DeleteKey));
+            if (grown == NULL) 
+            {
+                fprintf(stderr, "Memory allocation failed.\n");
+                free(keys);
+                fclose(file);
+                return NULL;
+            }
+            keys = grown;
+        }
+        keys[(*count)++] = key;
+    }
+
+    fclose(file);
+
+    // An empty file is a valid, empty set
+    return keys ? keys : malloc(sizeof(DeleteKey));
+}
+
+int studentInQuery(const stud *student, void *query) 
+{
+    const StudQuery *q = query;
+    return student->age >= q->minAge && student->age <= q->maxAge &&
+           student->average_score >= q->minScore && student->average_score <= q->maxScore;
+}
+
+stud *findStudentBySurname(stud_List *list, const char *surname) 
+{
+	// Check if the list is empty
+    if (list == NULL || list->head == NULL) 
+	{
+        printf("The list is empty or NULL.\n");
+        return NULL;  
+    }
+
+    // The first student of the chain is the first one in the list
+    SurnameSlot *slot = findSurnameSlot(list, surname);
+    if (slot == NULL || !list->index.stale) return slot ? slot->first : NULL;
+
+    // A stale chain may be out of order until the next sort, the list is not
+    stud *current = list->head;
+    while (strcmp(current->surname, surname) != 0) current = current->next;
+    return current;
+}
+
+void addStudentAfter(stud_List *list, const char *surname, stud *newStudentData) 
+{
+    METRICS_START(started);
+
+    // Search for a student with the specified last name
+    stud *foundStud = findStudentBySurname(list, surname);
+    if (foundStud == NULL) 
+    {
+        printf("No student found with the surname: %s\n", surname);
+        free(newStudentData);
+        return;
+    }
+
+    // Allocate memory for the new student
+    stud *newStud = allocStudNear(list, foundStud);
+    if (newStud == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    // Copy the data
+    copyStudentData(newStud, newStudentData);
+
+    // Insert a new student after the found one
+    newStud->next = foundStud->next;  
+    newStud->prev = foundStud;        
+
+    if (foundStud->next != NULL)      
+    {
+        foundStud->next->prev = newStud;  
+    }
+    foundStud->next = newStud;  
+
+    if (newStud->next == NULL)  
+    {
+        list->tail = newStud;   
+    }
+
+    indexStudent(list, newStud);
+    list->size++;
+
+    journalWrite(list, 'A', surname, newStud);
+    METRICS_RECORD(METRIC_ADD, started, 1, 0);
+}
+
+void outInit(OutBuf *out, FILE *sink) 
+{
+    out->data = NULL;
+    out->length = 0;
+    out->capacity = 0;
+    out->sink = sink;
+}
+
+/**
+ * @brief Makes room for more bytes in an output buffer.
+ * @param out A pointer to the buffer.
+ * @param extra The number of bytes about to be appended.
+ * @return void
+ */
+static void outReserve(OutBuf *out, size_t extra) 
+{
+    if (out->sink != NULL && out->length + extra > OUTBUF_FLUSH_SIZE) 
+    {
+        outFlush(out);
+    }
+
+    if (out->length + extra <= out->capacity) return;
+
+    size_t capacity = out->capacity ? out->capacity : 4096;
+    while (capacity < out->length + extra) capacity *= 2;
+
+    char *data = realloc(out->data, capacity);
+    if (data == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    out->data = data;
+    out->capacity = capacity;
+}
+
+void outWrite(OutBuf *out, const char *text, size_t length) 
+{
+    outReserve(out, length);
+    memcpy(out->data + out->length, text, length);
+    out->length += length;
+}
+
+void outPrintf(OutBuf *out, const char *format, ...) 
+{
+    va_list args;
+
+    va_start(args, format);
+    int length = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (length < 0) return;
+
+    outReserve(out, (size_t)length + 1);
+
+    va_start(args, format);
+    vsnprintf(out->data + out->length, (size_t)length + 1, format, args);
+    va_end(args);
+    out->length += (size_t)length;
+}
+
+/**
+ * @brief Appends a string left-justified in a field, like "%-Ns ".
+ * @param out A pointer to the buffer with enough room reserved.
+ * @param text The string.
+ * @param width The field width.
+ * @return void
+ */
+static void outField(OutBuf *out, const char *text, size_t width) 
+{
+    size_t length = strlen(text);
+    memcpy(out->data + out->length, text, length);
+    out->length += length;
+
+    while (length++ < width) out->data[out->length++] = ' ';
+}
+
+/**
+ * @brief Appends an integer left-justified in a field, like "%-Nd".
+ * @param out A pointer to the buffer with enough room reserved.
+ * @param value The integer.
+ * @param width The field width.
+ * @return void
+ */
+static void outIntField(OutBuf *out, int value, size_t width) 
+{
+    char digits[12];
+    size_t length = 0;
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+
+    do 
+    {
+        digits[length++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+
+    size_t written = length;
+    if (value < 0) 
+    {
+        out->data[out->length++] = '-';
+        written++;
+    }
+    while (length > 0) out->data[out->length++] = digits[--length];
+
+    while (written++ < width) out->data[out->length++] = ' ';
+}
+
+void outStudentRow(OutBuf *out, const stud *student) 
+{
+    // Same layout as "%-20s %-10s %-20s %-10d %-10d\n" without going through printf
+    outReserve(out, 128);
+    outField(out, student->surname, 20);
+    out->data[out->length++] = ' ';
+    outField(out, student->name, 10);
+    out->data[out->length++] = ' ';
+    outField(out, student->patronymic, 20);
+    out->data[out->length++] = ' ';
+    outIntField(out, student->age, 10);
+    out->data[out->length++] = ' ';
+    outIntField(out, student->average_score, 10);
+    out->data[out->length++] = '\n';
+}
+
+void outFlush(OutBuf *out) 
+{
+    if (out->sink != NULL && out->length > 0) 
+    {
+        fwrite(out->data, 1, out->length, out->sink);
+        out->length = 0;
+    }
+}
+
+void outFree(OutBuf *out) 
+{
+    outFlush(out);
+    free(out->data);
+    out->data = NULL;
+    out->length = out->capacity = 0;
+}
+
+void printStudentsByPerformanceHelper(stud_List *list, FILE *output) 
+{
+    printStudentsByBands(list, output, defaultPerfBands, DEFAULT_PERF_BAND_COUNT);
+}
+
+void printStudentsByBands(stud_List *list, FILE *output, const PerfBand *bands, size_t bandCount) 
+{
+    // Write the bands in order through one buffered writer
+    OutBuf out;
+    outInit(&out, output);
+    writeStudentsByBands(list, &out, bands, bandCount);
+    outFree(&out);
+}
+
+void writeStudentsByBands(stud_List *list, OutBuf *out, const PerfBand *bands, size_t bandCount) 
+{
+    // Check if the list is empty
+    if (list == NULL || list->head == NULL) 
+    {
+        outPrintf(out, "The list is empty.\n");
+        return;
+    }
+
+    for (size_t b = 0; b < bandCount; b++) 
+    {
+        size_t count = 0;
+        int minScore = 0, maxScore = 0;
+        long long sum = 0;
+
+        outPrintf(out, "\n%s (%d-%d):\n", bands[b].title, bands[b].minScore, bands[b].maxScore);
+
+        // Walk the scores of the band down from its top
+        for (BstNode *node = bstFloor(&list->scores, bands[b].maxScore); 
+             node != NULL && node->key >= bands[b].minScore; node = bstPrev(node)) 
+        {
+            // A score belongs to the first band containing it
+            size_t first = 0;
+            while (node->key < bands[first].minScore || node->key > bands[first].maxScore) first++;
+            if (first != b) continue;
+
+            for (BstEntry *entry = node->first; entry != NULL; entry = entry->next)
+            {
+#ifdef __GNUC__
+                // Students of one score are spread over the list; fetch the next
+                // record and entry while this row is formatted
+                BstEntry *ahead = entry->next;
+                if (ahead != NULL)
+                {
+                    __builtin_prefetch(ahead->payload);
+                    if (ahead->next != NULL) __builtin_prefetch(ahead->next);
+                }
+#endif
+                outStudentRow(out, entry->payload);
+            }
+
+            if (count == 0) maxScore = node->key;
+            minScore = node->key;
+            sum += (long long)node->key * (long long)node->count;
+            count += node->count;
+        }
+
+        if (count == 0) 
+        {
+            outPrintf(out, "No students found\n");
+            continue;
+        }
+
+        outPrintf(out, "Count: %zu, min: %d, max: %d, mean: %.2f\n",
+                  count, minScore, maxScore, (double)sum / (double)count);
+    }
+}
+
+/**
+ * @brief Writes one student of a score range as a table row.
+ * @param payload The student.
+ * @param key The score of the student.
+ * @param context The output buffer.
+ * @return void
+ */
+static void writeScoreRow(void *payload, int key, void *context) 
+{
+    (void)key;
+    outStudentRow(context, payload);
+}
+
+size_t printStudentsInScoreRange(stud_List *list, int minScore, int maxScore, OutBuf *out) 
+{
+    return bstVisitRange(&list->scores, minScore, maxScore, writeScoreRow, out);
+}
+
+/**
+ * @brief Reads a numeric field of a student.
+ * @param student The student.
+ * @param field The field.
+ * @return The value of the field.
+ */
+static int studFieldValue(const stud *student, StudField field) 
+{
+    return field == STUD_FIELD_AGE ? student->age : student->average_score;
+}
+
+// Student kept by topStudents, with its position in the list to break ties
+typedef struct 
+{
+    const stud *student;
+    int value;
+    size_t position;
+    
+} RankEntry;
+
+/**
+ * @brief Tells whether one ranked student comes before another.
+ * @param a The first entry.
+ * @param b The second entry.
+ * @param highest Non-zero if higher values come first.
+ * @return Non-zero if a is ranked before b.
+ */
+static int rankedBefore(const RankEntry *a, const RankEntry *b, int highest) 
+{
+    if (a->value != b->value) return highest ? a->value > b->value : a->value < b->value;
+    return a->position < b->position;
+}
+
+/**
+ * @brief Moves an entry down a heap whose root is the lowest ranked entry.
+ * @param heap The heap.
+ * @param count The number of entries.
+ * @param i The index of the entry.
+ * @param highest Non-zero if higher values come first.
+ * @return void
+ */
+static void rankSiftDown(RankEntry *heap, size_t count, size_t i, int highest) 
+{
+    for (;;) 
+    {
+        size_t worst = i;
+        size_t left = 2 * i + 1, right = left + 1;
+
+        if (left < count && rankedBefore(&heap[worst], &heap[left], highest)) worst = left;
+        if (right < count && rankedBefore(&heap[worst], &heap[right], highest)) worst = right;
+        if (worst == i) return;
+
+        RankEntry swap = heap[i];
+        heap[i] = heap[worst];
+        heap[worst] = swap;
+        i = worst;
+    }
+}
+
+size_t topStudents(stud_List *list, StudField field, size_t k, int highest, const stud **result) 
+{
+    if (k > list->size) k = list->size;
+    if (k == 0) return 0;
+
+    RankEntry *heap = malloc(k * sizeof(RankEntry));
+    if (heap == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t count = 0;
+    size_t position = 0;
+
+    // The root is the lowest ranked of the students kept, the first to make room
+    for (stud *current = list->head; current != NULL; current = current->next, position++) 
+    {
+        RankEntry entry = { current, studFieldValue(current, field), position };
+
+        if (count < k) 
+        {
+            size_t i = count++;
+            heap[i] = entry;
+            while (i > 0 && rankedBefore(&heap[(i - 1) / 2], &heap[i], highest)) 
+            {
+                RankEntry swap = heap[i];
+                heap[i] = heap[(i - 1) / 2];
+                heap[(i - 1) / 2] = swap;
+                i = (i - 1) / 2;
+            }
+        } 
+        
+        else if (rankedBefore(&entry, &heap[0], highest)) 
+        {
+            heap[0] = entry;
+            rankSiftDown(heap, count, 0, highest);
+        }
+    }
+
+    // Taking the lowest ranked off the heap fills the result from the back
+    for (size_t n = count; n > 0; n--) 
+    {
+        result[n - 1] = heap[0].student;
+        heap[0] = heap[n - 1];
+        rankSiftDown(heap, n - 1, 0, highest);
+    }
+
+    free(heap);
+    return count;
+}
+
+size_t printTopStudents(stud_List *list, StudField field, size_t k, int highest, OutBuf *out) 
+{
+    if (k > list->size) k = list->size;
+
+    const stud **top = malloc((k ? k : 1) * sizeof(*top));
+    if (top == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t count = topStudents(list, field, k, highest, top);
+    for (size_t i = 0; i < count; i++) 
+    {
+        outStudentRow(out, top[i]);
+    }
+
+    free(top);
+    return count;
+}
+
+/**
+ * @brief Finds the value that would be at a given index if the array were sorted.
+ * The array is reordered around it, like nth_element.
+ * @param values The values.
+ * @param count The number of values, at least one.
+ * @param nth The index, below count.
+ * @return The value.
+ */
+static int selectNth(int *values, size_t count, size_t nth) 
+{
+    size_t low = 0, high = count - 1;
+
+    while (low < high) 
+    {
+        // The median of three keeps sorted and reversed input linear
+        size_t mid = low + (high - low) / 2;
+        int a = values[low], b = values[mid], c = values[high];
+        int pivot = a < b ? (b < c ? b : (a < c ? c : a)) : (a < c ? a : (b < c ? c : b));
+
+        // Three-way partition, so the many equal grades are set aside in one go
+        size_t less = low, i = low, greater = high;
+        while (i <= greater) 
+        {
+            int value = values[i];
+            if (value < pivot) 
+            {
+                values[i++] = values[less];
+                values[less++] = value;
+            } 
+            
+            else if (value > pivot) 
+            {
+                // The pivot itself stays in the range, so greater cannot pass below low
+                values[i] = values[greater];
+                values[greater--] = value;
+            } 
+            
+            else 
+            {
+                i++;
+            }
+        }
+
+        if (nth < less) high = less - 1;
+        else if (nth > greater) low = greater + 1;
+        else return pivot;
+    }
+
+    return values[nth];
+}
+
+int studentPercentile(stud_List *list, StudField field, double percent, int *value) 
+{
+    if (list->size == 0 || !(percent >= 0.0 && percent <= 100.0)) return 0;
+
+    int *values = malloc(list->size * sizeof(int));
+    if (values == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t n = 0;
+    for (stud *current = list->head; current != NULL; current = current->next) 
+    {
+        values[n++] = studFieldValue(current, field);
+    }
+
+    // Nearest rank: the ceil(percent * n / 100)-th smallest value, the smallest for 0
+    double exact = percent / 100.0 * (double)n;
+    size_t rank = (size_t)exact;
+    if ((double)rank < exact) rank++;
+    if (rank == 0) rank = 1;
+    if (rank > n) rank = n;
+
+    *value = selectNth(values, n, rank - 1);
+    free(values);
+    return 1;
+}
+
+// Group of a group-by: the students sharing a key and the summary of their values
+typedef struct 
+{
+    // A student of the group, whose surname is the key of surname groups; NULL for an empty slot
+    const stud *first;
+
+    // The age or band number of the other groups
+    int key;
+    uint64_t hash;
+
+    size_t count;
+    long long sum;
+    int min;
+    int max;
+    
+} StudGroup;
+
+// Hash aggregation table of one group-by
+typedef struct 
+{
+    StudGroup *slots;
+    size_t capacity;
+    size_t used;
+    
+} GroupTable;
+
+/**
+ * @brief Finds the group of a key in a table, or the empty slot where it goes.
+ * @param table The table, with a non-zero capacity.
+ * @param groupKey The kind of key.
+ * @param student A student with the key.
+ * @param key The numeric key, for age and band groups.
+ * @param hash The hash of the key.
+ * @return The matching or empty slot.
+ */
+static StudGroup *probeGroup(GroupTable *table, GroupKey groupKey, const stud *student, int key, uint64_t hash) 
+{
+    size_t mask = table->capacity - 1;
+    size_t i = (size_t)hash & mask;
+
+    while (table->slots[i].first != NULL) 
+    {
+        StudGroup *group = &table->slots[i];
+        if (group->hash == hash && 
+            (groupKey == GROUP_BY_SURNAME ? compareSurnameKey(group->first, &student->key, student->surname) == 0 
+                                          : group->key == key)) 
+        {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+
+    return &table->slots[i];
+}
+
+/**
+ * @brief Doubles the capacity of a group table.
+ * @param table The table.
+ * @param groupKey The kind of key.
+ * @return void
+ */
+static void growGroupTable(GroupTable *table, GroupKey groupKey) 
+{
+    StudGroup *old = table->slots;
+    size_t oldCapacity = table->capacity;
+
+    table->capacity = oldCapacity ? oldCapacity * 2 : 64;
+    table->slots = calloc(table->capacity, sizeof(StudGroup));
+
+    if (table->slots == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < oldCapacity; i++) 
+    {
+        if (old[i].first != NULL) 
+        {
+            *probeGroup(table, groupKey, old[i].first, old[i].key, old[i].hash) = old[i];
+        }
+    }
+
+    free(old);
+}
+
+/**
+ * @brief Orders age and band groups by key.
+ * @param a The first group.
+ * @param b The second group.
+ * @return Negative, zero or positive, like strcmp.
+ */
+static int compareGroupKeys(const void *a, const void *b) 
+{
+    int x = ((const StudGroup *)a)->key, y = ((const StudGroup *)b)->key;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Orders surname groups by surname.
+ * @param a The first group.
+ * @param b The second group.
+ * @return Negative, zero or positive, like strcmp.
+ */
+static int compareGroupSurnames(const void *a, const void *b) 
+{
+    const stud *x = ((const StudGroup *)a)->first, *y = ((const StudGroup *)b)->first;
+    return compareSurnameKey(x, &y->key, y->surname);
+}
+
+size_t writeGroups(stud_List *list, const GroupQuery *queries, size_t queryCount, OutBuf *out) 
+{
+    GroupTable *tables = calloc(queryCount ? queryCount : 1, sizeof(GroupTable));
+    if (tables == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // One pass feeds every group-by
+    for (stud *current = list->head; current != NULL; current = current->next) 
+    {
+        for (size_t q = 0; q < queryCount; q++) 
+        {
+            const GroupQuery *query = &queries[q];
+            GroupTable *table = &tables[q];
+            int key = 0;
+            uint64_t hash;
+
+            if (query->key == GROUP_BY_SURNAME) 
+            {
+                hash = hashSurname(&current->key, current->surname);
+            } 
+            
+            else 
+            {
+                if (query->key == GROUP_BY_AGE) 
+                {
+                    key = current->age;
+                } 
+                
+                else 
+                {
+                    // The first band containing the score, as in the performance report
+                    size_t b = 0;
+                    while (b < query->bandCount && 
+                           (current->average_score < query->bands[b].minScore || 
+                            current->average_score > query->bands[b].maxScore)) b++;
+                    if (b == query->bandCount) continue;
+                    key = (int)b;
+                }
+
+                // Finish the key with the splitmix64 mixer so nearby keys spread out
+                hash = (uint64_t)(uint32_t)key * 0x9E3779B97F4A7C15ULL;
+                hash ^= hash >> 31;
+                hash *= 0xBF58476D1CE4E5B9ULL;
+                hash ^= hash >> 27;
+            }
+
+            // Keep the load factor at or below one half
+            if (2 * (table->used + 1) > table->capacity) growGroupTable(table, query->key);
+
+            StudGroup *group = probeGroup(table, query->key, current, key, hash);
+            int value = studFieldValue(current, query->value);
+
+            if (group->first == NULL) 
+            {
+                group->first = current;
+                group->key = key;
+                group->hash = hash;
+                group->min = group->max = value;
+                table->used++;
+            }
+
+            group->count++;
+            group->sum += value;
+            if (value < group->min) group->min = value;
+            if (value > group->max) group->max = value;
+        }
+    }
+
+    static const char *const keyTitles[] = { "Age", "Surname", "Band" };
+    size_t total = 0;
+
+    for (size_t q = 0; q < queryCount; q++) 
+    {
+        const GroupQuery *query = &queries[q];
+        GroupTable *table = &tables[q];
+
+        // Move the groups to the front of the table and put them in key order
+        size_t n = 0;
+        for (size_t i = 0; i < table->capacity; i++) 
+        {
+            if (table->slots[i].first != NULL) table->slots[n++] = table->slots[i];
+        }
+        if (n > 0) 
+        {
+            qsort(table->slots, n, sizeof(StudGroup), query->key == GROUP_BY_SURNAME ? compareGroupSurnames : compareGroupKeys);
+        }
+
+        outPrintf(out, "\n%s by %s:\n", query->value == STUD_FIELD_AGE ? "Age" : "Grade", keyTitles[query->key]);
+        outPrintf(out, "%-20s %-10s %-12s %-10s %-10s %-10s\n", keyTitles[query->key], "Count", "Sum", "Min", "Max", "Mean");
+        outPrintf(out, "-------------------------------------------------------------------------------\n");
+
+        for (size_t i = 0; i < n; i++) 
+        {
+            const StudGroup *group = &table->slots[i];
+
+            if (query->key == GROUP_BY_SURNAME) outPrintf(out, "%-20s ", group->first->surname);
+            else if (query->key == GROUP_BY_BAND) outPrintf(out, "%-20s ", query->bands[group->key].title);
+            else outPrintf(out, "%-20d ", group->key);
+
+            outPrintf(out, "%-10zu %-12lld %-10d %-10d %-10.2f\n", 
+                      group->count, group->sum, group->min, group->max, (double)group->sum / (double)group->count);
+        }
+        outPrintf(out, "%zu groups\n", n);
+
+        total += n;
+        free(table->slots);
+    }
+
+    free(tables);
+    return total;
+}
+
+void printGroups(stud_List *list, FILE *output, const GroupQuery *queries, size_t queryCount) 
+{
+    OutBuf out;
+    outInit(&out, output);
+    writeGroups(list, queries, queryCount, &out);
+    outFree(&out);
+}
+
+void printStudByPerf(stud_List *list) 
+{
+    printStudentsByPerformanceHelper(list, stdout);
+}
+
+void freeList(stud_List *list) 
+{
+    // Records live in pool blocks, so only the blocks are freed
+    StudBlock *block = list->pool.blocks;
+    while (block != NULL) 
+    {
+        StudBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    // Ordered index nodes are allocated one by one, the head included
+    OrderNode *node = list->order.head;
+    while (node != NULL) 
+    {
+        OrderNode *next = node->next[0];
+        free(node);
+        node = next;
+    }
+
+    trieFree(list->trie);
+    bstClear(&list->scores);
+    free(list->index.slots);
+    freeColumns(&list->columns);
+    free(list);
+}
+
+// Contents of a file mapped into memory, or read into a buffer where mmap is unavailable
+typedef struct 
+{
+    const char *data;
+    size_t size;
+    int mapped;
+    
+} MappedFile;
+
+/**
+ * @brief Maps a whole file into memory for reading.
+ * @param filename The name of the file.
+ * @param file Receives the contents of the file.
+ * @return 1 on success, 0 if the file could not be opened or read.
+ */
+static int mapFile(const char *filename, MappedFile *file) 
+{
+    file->data = NULL;
+    file->size = 0;
+    file->mapped = 0;
+
+#ifdef LIST_POSIX
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) 
+    {
+        close(fd);
+        return 0;
+    }
+
+    // An empty file cannot be mapped but is still a valid empty list
+    if (st.st_size > 0) 
+    {
+        void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) 
+        {
+            close(fd);
+            return 0;
+        }
+#ifdef MADV_SEQUENTIAL
+        madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+        file->data = data;
+        file->size = (size_t)st.st_size;
+        file->mapped = 1;
+    }
+
+    close(fd);
+    return 1;
+#else
+    FILE *stream = fopen(filename, "rb");
+    if (!stream) return 0;
+
+    // Without mmap, read the whole file with one call
+    fseek(stream, 0, SEEK_END);
+    long size = ftell(stream);
+    fseek(stream, 0, SEEK_SET);
+
+    if (size > 0) 
+    {
+        char *data = malloc((size_t)size);
+        if (data == NULL || fread(data, 1, (size_t)size, stream) != (size_t)size) 
+        {
+            free(data);
+            fclose(stream);
+            return 0;
+        }
+        file->data = data;
+        file->size = (size_t)size;
+    }
+
+    fclose(stream);
+    return 1;
+#endif
+}
+
+/**
+ * @brief Releases a file mapped by mapFile.
+ * @param file The mapped file.
+ * @return void
+ */
+static void unmapFile(MappedFile *file) 
+{
+#ifdef LIST_POSIX
+    if (file->mapped) munmap((void *)file->data, file->size);
+#else
+    free((void *)file->data);
+#endif
+    file->data = NULL;
+    file->size = 0;
+}
+
+/**
+ * @brief Checks for the characters that scanf treats as whitespace.
+ * @param c The character.
+ * @return Non-zero if c is whitespace.
+ */
+static int isScanSpace(char c) 
+{
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/**
+ * @brief Scans a string field like the scanf "%Ns" conversion.
+ * Leading whitespace is skipped and at most width characters are taken;
+ * the rest of a longer word is left for the next field.
+ * @param pos The current position, advanced past the field.
+ * @param end The end of the input.
+ * @param dest The destination buffer of at least width + 1 bytes.
+ * @param width The maximum field width.
+ * @return 1 if a field was read, 0 at the end of the input.
+ */
+static int scanWord(const char **pos, const char *end, char *dest, size_t width) 
+{
+    const char *p = *pos;
+    while (p < end && isScanSpace(*p)) p++;
+    if (p == end) 
+    {
+        *pos = p;
+        return 0;
+    }
+
+    size_t length = 0;
+    while (p + length < end && length < width && !isScanSpace(p[length])) length++;
+
+    memcpy(dest, p, length);
+    dest[length] = '\0';
+    *pos = p + length;
+    return 1;
+}
+
+/**
+ * @brief Scans an integer field like the scanf "%d" conversion.
+ * @param pos The current position, advanced past the field.
+ * @param end The end of the input.
+ * @param value Receives the value.
+ * @return 1 if a number was read, 0 if the input does not start with one.
+ */
+static int scanInt(const char **pos, const char *end, int *value) 
+{
+    const char *p = *pos;
+    while (p < end && isScanSpace(*p)) p++;
+
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) 
+    {
+        negative = *p == '-';
+        p++;
+    }
+
+    if (p == end || *p < '0' || *p > '9') 
+    {
+        *pos = p;
+        return 0;
+    }
+
+    // Convert like strtol, saturating at the limits of long, then narrow
+    // to int the same way the C library's scanf does
+    unsigned long magnitude = 0;
+    unsigned long limit = negative ? (unsigned long)LONG_MAX + 1 : (unsigned long)LONG_MAX;
+    while (p < end && *p >= '0' && *p <= '9') 
+    {
+        unsigned long digit = (unsigned long)(*p - '0');
+        magnitude = magnitude > (limit - digit) / 10 ? limit : magnitude * 10 + digit;
+        p++;
+    }
+
+    long result = negative ? (long)(0 - magnitude) : (long)magnitude;
+    *value = (int)result;
+    *pos = p;
+    return 1;
+}
+
+/**
+ * @brief Appends the records of a mapped binary roster file to the list.
+ * @param list A pointer to the student list.
+ * @param data The contents of the file.
+ * @param size The size of the file.
+ * @param filename The name of the file, for error messages.
+ * @return The generation of the roster, 0 for version 1 files.
+ */
+static uint64_t loadBinaryRecords(stud_List *list, const char *data, size_t size, const char *filename);
+
+/**
+ * @brief Decodes the records of a mapped packed roster file and appends them to the list.
+ * @param list A pointer to the student list.
+ * @param data The contents of the file.
+ * @param size The size of the file.
+ * @param filename The name of the file, for error messages.
+ * @return void
+ */
+static void loadPackedRecords(stud_List *list, const char *data, size_t size, const char *filename);
+
+/**
+ * @brief Parses the records of a mapped text file and appends them to the list.
+ * @param list A pointer to the student list.
+ * @param data The contents of the file.
+ * @param size The size of the file.
+ * @return void
+ */
+static void loadTextRecords(stud_List *list, const char *data, size_t size);
+
+void loadListFromFile(stud_List *list, const char *filename) 
+{
+    METRICS_START(started);
+    METRICS_VALUE(size_t, sizeBefore, list->size);
+
+    char journalPath[FILENAME_MAX];
+    char oldJournalPath[FILENAME_MAX];
+    snprintf(journalPath, sizeof(journalPath), "%s.journal", filename);
+    snprintf(oldJournalPath, sizeof(oldJournalPath), "%s.journal.old", filename);
+
+    MappedFile file;
+
+    if (!mapFile(filename, &file)) 
+    {
+        perror("Error opening file for reading");
+
+        // Changes made before the first snapshot only live in the journal
+        replayJournal(list, oldJournalPath, 0);
+        replayJournal(list, journalPath, 0);
+        return;
+    }
+
+    uint64_t generation = 0;
+    if (file.size >= ROSTER_V1_HEADER_SIZE && memcmp(file.data, ROSTER_MAGIC, 8) == 0) 
+    {
+        generation = loadBinaryRecords(list, file.data, file.size, filename);
+    } 
+    
+    else if (file.size >= sizeof(PackHeader) && memcmp(file.data, PACK_MAGIC, 8) == 0) 
+    {
+        loadPackedRecords(list, file.data, file.size, filename);
+    } 
+    
+    else 
+    {
+        loadTextRecords(list, file.data, file.size);
+    }
+
+    METRICS_VALUE(size_t, bytesRead, file.size);
+    unmapFile(&file);
+    buildOrderIndex(list);
+    buildScoreIndex(list);
+
+    // Apply the changes made since the snapshot was written; a journal rotated
+    // out for a background snapshot that never reached the disk comes first
+    replayJournal(list, oldJournalPath, generation);
+    replayJournal(list, journalPath, generation);
+    METRICS_RECORD(METRIC_LOAD, started, list->size - sizeBefore, bytesRead);
+}
+
+// Slot of the duplicate detection set; an empty slot has no student
+typedef struct 
+{
+    stud *student;
+    uint64_t hash;
+    
+} DedupSlot;
+
+/**
+ * @brief Hashes the fields that identify a student for duplicate detection.
+ * @param student The student.
+ * @return The 64-bit hash of the surname, name, patronymic and age.
+ */
+static uint64_t hashStudentIdentity(const stud *student) 
+{
+    uint64_t hash = hashSurname(&student->key, student->surname);
+
+    // Fold in the other text fields with FNV-1a, separated like words
+    for (const char *c = student->name; *c; c++) 
+    {
+        hash = (hash ^ (unsigned char)*c) * 1099511628211ULL;
+    }
+    hash = (hash ^ ' ') * 1099511628211ULL;
+    for (const char *c = student->patronymic; *c; c++) 
+    {
+        hash = (hash ^ (unsigned char)*c) * 1099511628211ULL;
+    }
+
+    hash ^= (uint32_t)student->age;
+    hash ^= hash >> 31;
+    hash *= 0x94D049BB133111EBULL;
+    hash ^= hash >> 29;
+    return hash;
+}
+
+/**
+ * @brief Tells whether two students have the same surname, name, patronymic and age.
+ * @param a The first student.
+ * @param b The second student.
+ * @return Non-zero if they are duplicates.
+ */
+static int sameStudentIdentity(const stud *a, const stud *b) 
+{
+    return a->age == b->age && a->key.name == b->key.name &&
+           compareSurnameKey(a, &b->key, b->surname) == 0 &&
+           strcmp(a->name, b->name) == 0 && strcmp(a->patronymic, b->patronymic) == 0;
+}
+
+size_t removeDuplicateStudents(stud_List *list, DedupPolicy policy) 
+{
+    // A load factor of at most one half, as in the surname index
+    size_t capacity = 16;
+    while (capacity < list->size * 2) capacity *= 2;
+
+    DedupSlot *slots = calloc(capacity, sizeof(DedupSlot));
+    if (slots == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return 0;
+    }
+
+    Journal *journal = batchBegin(list);
+    size_t mask = capacity - 1;
+    size_t removed = 0;
+    int changed = 0;
+
+    stud *current = list->head;
+    while (current != NULL) 
+    {
+        stud *next = current->next;
+        uint64_t hash = hashStudentIdentity(current);
+        size_t i = (size_t)hash & mask;
+
+        while (slots[i].student != NULL && 
+               (slots[i].hash != hash || !sameStudentIdentity(slots[i].student, current))) 
+        {
+            i = (i + 1) & mask;
+        }
+
+        if (slots[i].student == NULL) 
+        {
+            slots[i].student = current;
+            slots[i].hash = hash;
+        } 
+        
+        else 
+        {
+            stud *first = slots[i].student;
+            int score = first->average_score;
+
+            if (policy == DEDUP_LAST_WINS) score = current->average_score;
+            if (policy == DEDUP_MAX_SCORE && current->average_score > score) score = current->average_score;
+
+            if (score != first->average_score) 
+            {
+                setStudentScore(list, first, score);
+                changed = 1;
+            }
+
+            removeStudent(list, current);
+            removed++;
+        }
+        current = next;
+    }
+
+    free(slots);
+    batchEnd(list, journal, removed + (size_t)changed);
+    return removed;
+}
+
+size_t importListFromFile(stud_List *list, const char *filename, DedupPolicy policy) 
+{
+    Journal *journal = batchBegin(list);
+    size_t sizeBefore = list->size;
+
+    loadListFromFile(list, filename);
+    size_t removed = removeDuplicateStudents(list, policy);
+
+    // Imported students that all merged into earlier ones still changed grades
+    batchEnd(list, journal, list->size - sizeBefore + removed);
+    return removed;
+}
+
+/**
+ * @brief Computes the checksum of binary roster records.
+ * Whole 64-bit words are hashed FNV-style; calls may be chained as long as
+ * every chunk but the last has a length divisible by eight.
+ * @param hash The checksum of the previous chunks, or the seed.
+ * @param data The bytes to hash.
+ * @param length The number of bytes.
+ * @return The updated checksum.
+ */
+static uint64_t rosterChecksum(uint64_t hash, const void *data, size_t length) 
+{
+    const unsigned char *bytes = data;
+    uint64_t word;
+
+    while (length >= 8) 
+    {
+        memcpy(&word, bytes, 8);
+        hash = (hash ^ word) * 1099511628211ULL;
+        bytes += 8;
+        length -= 8;
+    }
+    while (length > 0) 
+    {
+        hash = (hash ^ *bytes++) * 1099511628211ULL;
+        length--;
+    }
+
+    return hash;
+}
+
+#define ROSTER_CHECKSUM_SEED 14695981039346656037ULL
+
+static uint64_t loadBinaryRecords(stud_List *list, const char *data, size_t size, const char *filename) 
+{
+    RosterHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(&header, data, ROSTER_V1_HEADER_SIZE);
+
+    size_t headerSize = header.version == 1 ? ROSTER_V1_HEADER_SIZE : sizeof(header);
+    if ((header.version != 1 && header.version != ROSTER_VERSION) || size < headerSize) 
+    {
+        fprintf(stderr, "%s: unsupported or truncated roster file\n", filename);
+        return 0;
+    }
+    memcpy(&header, data, headerSize);
+
+    size_t payload = size - headerSize;
+    if (header.recordSize != sizeof(StudRecord) ||
+        header.count != payload / sizeof(StudRecord) || payload % sizeof(StudRecord) != 0) 
+    {
+        fprintf(stderr, "%s: unsupported or truncated roster file\n", filename);
+        return 0;
+    }
+
+    const char *records = data + headerSize;
+    if (rosterChecksum(ROSTER_CHECKSUM_SEED, records, payload) != header.checksum) 
+    {
+        fprintf(stderr, "%s: roster checksum mismatch\n", filename);
+        return 0;
+    }
+
+    for (uint64_t i = 0; i < header.count; i++) 
+    {
+        StudRecord record;
+        memcpy(&record, records + i * sizeof(StudRecord), sizeof(record));
+
+        stud *newStudent = allocStud(list);
+        if (!newStudent) 
+        {
+            perror("Memory allocation failed");
+            return header.generation;
+        }
+
+        // Fixed-width fields are copied as they are, only the terminators are enforced
+        memcpy(newStudent->surname, record.surname, sizeof(record.surname));
+        memcpy(newStudent->name, record.name, sizeof(record.name));
+        memcpy(newStudent->patronymic, record.patronymic, sizeof(record.patronymic));
+        newStudent->surname[sizeof(newStudent->surname) - 1] = '\0';
+        newStudent->name[sizeof(newStudent->name) - 1] = '\0';
+        newStudent->patronymic[sizeof(newStudent->patronymic) - 1] = '\0';
+        newStudent->age = record.age;
+        newStudent->average_score = record.average_score;
+
+        newStudent->next = NULL;
+        newStudent->prev = list->tail;
+
+        if (list->head == NULL) 
+        {
+            list->head = newStudent;
+        } 
+
+        else 
+        {
+            list->tail->next = newStudent;
+        }
+        list->tail = newStudent;
+
+        // The ordered index is built in one go once the whole file is read
+        indexStudentAt(list, newStudent, 0);
+        list->size++;
+    }
+
+    return header.generation;
+}
+
+static void loadTextRecords(stud_List *list, const char *data, size_t size) 
+{
+    const char *pos = data;
+    const char *end = data + size;
+
+    for (;;) 
+    {
+        // Parse straight into a pool record; an unused record is given back
+        stud *newStudent = allocStud(list);
+
+        if (!newStudent) 
+        {
+            perror("Memory allocation failed");
+            break;
+        }
+
+        if (!scanWord(&pos, end, newStudent->surname, sizeof(newStudent->surname) - 1) ||
+            !scanWord(&pos, end, newStudent->name, sizeof(newStudent->name) - 1) ||
+            !scanWord(&pos, end, newStudent->patronymic, sizeof(newStudent->patronymic) - 1) ||
+            !scanInt(&pos, end, &newStudent->age) ||
+            !scanInt(&pos, end, &newStudent->average_score)) 
+        {
+            freeStud(list, newStudent);
+            break;
+        }
+
+        newStudent->next = NULL;
+        newStudent->prev = list->tail;
+
+        if (list->head == NULL) 
+        {
+            list->head = newStudent;
+        } 
+
+        else 
+        {
+            list->tail->next = newStudent;
+        }
+        list->tail = newStudent;
+
+        // The ordered index is built in one go once the whole file is read
+        indexStudentAt(list, newStudent, 0);
+        list->size++;
+    }
+}
+
+// Smallest piece of a file worth a thread of its own
+#define PARALLEL_MIN_CHUNK (256 * 1024)
+
+// Piece of a text file parsed and sorted by one thread
+typedef struct 
+{
+    const char *begin;
+    const char *end;
+
+    // Records are parsed into a pool of their own, handed to the list at the end
+    StudPool pool;
+    stud **records;
+    size_t count;
+    size_t capacity;
+
+    // Position of the piece in the merged array
+    size_t offset;
+    stud **sorted;
+    stud **buffer;
+
+    // Set if a line does not hold exactly one record
+    int irregular;
+    
+} LoadChunk;
+
+// Part of the merge of two sorted runs: output positions first to last
+typedef struct 
+{
+    stud **left;
+    size_t leftCount;
+    stud **right;
+    size_t rightCount;
+    stud **dest;
+    size_t first;
+    size_t last;
+    
+} MergeTask;
+
+// Part of the sorted array whose students are linked into the list and the indexes
+typedef struct 
+{
+    stud **items;
+    size_t count;
+    size_t first;
+    size_t last;
+
+    // Set for every position where a new surname starts
+    unsigned char *surnameStarts;
+
+    // Ordered index nodes of the part, chained on every level
+    uint32_t seed;
+    int level;
+    OrderNode *firstNode[ORDER_MAX_LEVEL];
+    OrderNode *lastNode[ORDER_MAX_LEVEL];
+    
+} LinkTask;
+
+#ifdef LIST_THREADS
+// Tasks handed out to the threads one at a time
+typedef struct 
+{
+    char *tasks;
+    size_t size;
+    size_t count;
+    size_t next;
+    void (*run)(void *task);
+    pthread_mutex_t lock;
+    
+} TaskQueue;
+
+/**
+ * @brief Runs tasks from a queue until it is empty.
+ * @param arg A pointer to the queue.
+ * @return NULL
+ */
+static void *taskWorker(void *arg) 
+{
+    TaskQueue *queue = arg;
+
+    for (;;) 
+    {
+        pthread_mutex_lock(&queue->lock);
+        size_t task = queue->next++;
+        pthread_mutex_unlock(&queue->lock);
+
+        if (task >= queue->count) break;
+        queue->run(queue->tasks + task * queue->size);
+    }
+    return NULL;
+}
+#endif
+
+/**
+ * @brief Runs an array of independent tasks on up to the given number of threads.
+ * The calling thread takes part; if threads cannot be created, it runs the tasks alone.
+ * @param tasks The task array.
+ * @param size The size of one task.
+ * @param count The number of tasks.
+ * @param run The function run on every task.
+ * @param threads The number of threads.
+ * @return void
+ */
+static void runTasks(void *tasks, size_t size, size_t count, void (*run)(void *task), int threads) 
+{
+#ifdef LIST_THREADS
+    TaskQueue queue = { tasks, size, count, 0, run, PTHREAD_MUTEX_INITIALIZER };
+    pthread_t workers[64];
+    int started = 0;
+
+    if (threads > 64) threads = 64;
+    if ((size_t)threads > count) threads = (int)count;
+
+    while (started < threads - 1 && pthread_create(&workers[started], NULL, taskWorker, &queue) == 0) 
+    {
+        started++;
+    }
+
+    taskWorker(&queue);
+
+    for (int i = 0; i < started; i++) 
+    {
+        pthread_join(workers[i], NULL);
+    }
+    pthread_mutex_destroy(&queue.lock);
+#else
+    (void)threads;
+    for (size_t i = 0; i < count; i++) 
+    {
+        run((char *)tasks + i * size);
+    }
+#endif
+}
+
+/**
+ * @brief Parses a piece of a text file, one record per line.
+ * @param task A pointer to the LoadChunk.
+ * @return void
+ */
+static void parseChunk(void *task) 
+{
+    LoadChunk *chunk = task;
+    const char *pos = chunk->begin;
+    const char *end = chunk->end;
+
+    while (pos < end) 
+    {
+        // Blank lines are skipped, as the serial scanner skips all whitespace
+        const char *line = pos;
+        while (pos < end && *pos != '\n' && isScanSpace(*pos)) pos++;
+        if (pos == end) break;
+        if (*pos == '\n') 
+        {
+            pos++;
+            continue;
+        }
+
+        if (chunk->count == chunk->capacity) 
+        {
+            size_t capacity = chunk->capacity ? chunk->capacity * 2 : 1024;
+            stud **records = realloc(chunk->records, capacity * sizeof(stud *));
+            if (records == NULL) 
+            {
+                chunk->irregular = 1;
+                return;
+            }
+            chunk->records = records;
+            chunk->capacity = capacity;
+        }
+
+        stud *student = poolAlloc(&chunk->pool);
+        if (student == NULL) 
+        {
+            chunk->irregular = 1;
+            return;
+        }
+
+        // A record must not reach into the next line, and nothing may follow it
+        if (!scanWord(&pos, end, student->surname, sizeof(student->surname) - 1) ||
+            !scanWord(&pos, end, student->name, sizeof(student->name) - 1) ||
+            !scanWord(&pos, end, student->patronymic, sizeof(student->patronymic) - 1) ||
+            !scanInt(&pos, end, &student->age) ||
+            !scanInt(&pos, end, &student->average_score) ||
+            memchr(line, '\n', (size_t)(pos - line)) != NULL) 
+        {
+            chunk->irregular = 1;
+            return;
+        }
+
+        while (pos < end && *pos != '\n' && isScanSpace(*pos)) pos++;
+        if (pos < end && *pos != '\n') 
+        {
+            chunk->irregular = 1;
+            return;
+        }
+
+        // Sorting and indexing the chunks compare the keys
+        setStudentKey(student);
+        chunk->records[chunk->count++] = student;
+    }
+}
+
+/**
+ * @brief Moves the records of a piece to its place in the merged array and sorts them there.
+ * @param task A pointer to the LoadChunk.
+ * @return void
+ */
+static void sortChunk(void *task) 
+{
+    LoadChunk *chunk = task;
+
+    memcpy(chunk->sorted + chunk->offset, chunk->records, chunk->count * sizeof(stud *));
+    sortStudArray(chunk->sorted + chunk->offset, chunk->buffer + chunk->offset, chunk->count);
+}
+
+/**
+ * @brief Finds how many students of the left run come first among the first k of a stable merge.
+ * @param k The number of merged students.
+ * @param left The left run; it wins ties.
+ * @param leftCount The length of the left run.
+ * @param right The right run.
+ * @param rightCount The length of the right run.
+ * @return The number of students taken from the left run.
+ */
+static size_t mergeSplit(size_t k, stud **left, size_t leftCount, stud **right, size_t rightCount) 
+{
+    size_t low = k > rightCount ? k - rightCount : 0;
+    size_t high = k < leftCount ? k : leftCount;
+
+    // The largest i whose last left student does not follow the first remaining right one
+    while (low < high) 
+    {
+        size_t i = low + (high - low + 1) / 2;
+        if (compareStudents(left[i - 1], right[k - i]) > 0) high = i - 1;
+        else low = i;
+    }
+    return low;
+}
+
+/**
+ * @brief Merges one part of two sorted runs.
+ * @param task A pointer to the MergeTask.
+ * @return void
+ */
+static void mergeRuns(void *task) 
+{
+    MergeTask *merge = task;
+
+    size_t i = mergeSplit(merge->first, merge->left, merge->leftCount, merge->right, merge->rightCount);
+    size_t j = merge->first - i;
+    size_t leftEnd = mergeSplit(merge->last, merge->left, merge->leftCount, merge->right, merge->rightCount);
+    size_t rightEnd = merge->last - leftEnd;
+    size_t k = merge->first;
+
+    while (i < leftEnd && j < rightEnd) 
+    {
+        merge->dest[k++] = compareStudents(merge->left[i], merge->right[j]) <= 0 ? merge->left[i++] : merge->right[j++];
+    }
+    while (i < leftEnd) merge->dest[k++] = merge->left[i++];
+    while (j < rightEnd) merge->dest[k++] = merge->right[j++];
+}
+
+/**
+ * @brief Links a part of a sorted array into the list, the surname chains and ordered index nodes.
+ * Sorting puts equal surnames next to each other, so every chain is a run of the array.
+ * @param task A pointer to the LinkTask.
+ * @return void
+ */
+static void linkRange(void *task) 
+{
+    LinkTask *link = task;
+    stud **items = link->items;
+    OrderNode *previous = NULL;
+
+    link->level = 1;
+    for (int i = 0; i < ORDER_MAX_LEVEL; i++) 
+    {
+        link->firstNode[i] = link->lastNode[i] = NULL;
+    }
+
+    for (size_t i = link->first; i < link->last; i++) 
+    {
+        stud *student = items[i];
+        student->prev = i > 0 ? items[i - 1] : NULL;
+        student->next = i + 1 < link->count ? items[i + 1] : NULL;
+
+        int sameBefore = student->prev != NULL && compareSurnameKey(student->prev, &student->key, student->surname) == 0;
+        int sameAfter = student->next != NULL && compareSurnameKey(student->next, &student->key, student->surname) == 0;
+        student->prevSame = sameBefore ? student->prev : NULL;
+        student->nextSame = sameAfter ? student->next : NULL;
+        link->surnameStarts[i] = !sameBefore;
+
+        // Nodes are chained within the part and stitched to the other parts afterwards
+        int level = orderRandomLevel(&link->seed);
+        OrderNode *node = orderNewNode(student, level);
+        node->prev = previous;
+        previous = node;
+        student->orderNode = node;
+
+        for (int l = 0; l < level; l++) 
+        {
+            if (link->lastNode[l]) link->lastNode[l]->next[l] = node;
+            else link->firstNode[l] = node;
+            link->lastNode[l] = node;
+        }
+        if (level > link->level) link->level = level;
+    }
+}
+
+/**
+ * @brief Merges sorted runs pairwise until one is left.
+ * @param items The runs, one after another; receives the result.
+ * @param buffer Scratch space for as many students.
+ * @param starts The start of every run, followed by the total count; overwritten.
+ * @param runs The number of runs.
+ * @param threads The number of threads.
+ * @return void
+ */
+static void mergeAllRuns(stud **items, stud **buffer, size_t *starts, size_t runs, int threads) 
+{
+    size_t total = starts[runs];
+    stud **from = items;
+    stud **to = buffer;
+
+    MergeTask *tasks = malloc(((size_t)threads + runs) * sizeof(MergeTask));
+    if (tasks == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    while (runs > 1) 
+    {
+        size_t count = 0;
+        size_t merged = 0;
+
+        for (size_t r = 0; r < runs; r += 2) 
+        {
+            size_t begin = starts[r];
+            size_t middle = starts[r + 1];
+            size_t end = r + 2 <= runs ? starts[r + 2] : middle;
+            size_t length = end - begin;
+
+            // Every pair gets a share of the threads matching its size
+            size_t parts = total > 0 ? (size_t)threads * length / total : 1;
+            if (parts < 1) parts = 1;
+
+            for (size_t part = 0; part < parts; part++) 
+            {
+                MergeTask *task = &tasks[count++];
+                task->left = from + begin;
+                task->leftCount = middle - begin;
+                task->right = from + middle;
+                task->rightCount = end - middle;
+                task->dest = to + begin;
+                task->first = length * part / parts;
+                task->last = length * (part + 1) / parts;
+            }
+
+            starts[merged++] = begin;
+        }
+
+        runTasks(tasks, sizeof(MergeTask), count, mergeRuns, threads);
+
+        starts[merged] = total;
+        runs = merged;
+
+        stud **swap = from;
+        from = to;
+        to = swap;
+    }
+
+    if (from != items) memcpy(items, from, total * sizeof(stud *));
+    free(tasks);
+}
+
+void loadSortedListFromFile(stud_List *list, const char *filename, int threads) 
+{
+    if (threads <= 0) 
+    {
+#ifdef LIST_POSIX
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = processors > 0 ? (int)processors : 1;
+#else
+        threads = 1;
+#endif
+    }
+    if (threads > 64) threads = 64;
+
+    char journalPath[FILENAME_MAX];
+    snprintf(journalPath, sizeof(journalPath), "%s.journal", filename);
+
+    FILE *journal = fopen(journalPath, "r");
+    if (journal == NULL) 
+    {
+        // A journal left by an unfinished background snapshot counts as well
+        snprintf(journalPath, sizeof(journalPath), "%s.journal.old", filename);
+        journal = fopen(journalPath, "r");
+    }
+    if (journal != NULL) fclose(journal);
+
+    MappedFile file;
+    int mapped = journal == NULL && list->size == 0 && mapFile(filename, &file);
+
+    size_t chunks = 0;
+    if (mapped && !(file.size >= 8 && (memcmp(file.data, ROSTER_MAGIC, 8) == 0 || memcmp(file.data, PACK_MAGIC, 8) == 0))) 
+    {
+        chunks = file.size / PARALLEL_MIN_CHUNK;
+        if (chunks > (size_t)threads) chunks = (size_t)threads;
+    }
+
+    LoadChunk *pieces = chunks > 1 ? calloc(chunks, sizeof(LoadChunk)) : NULL;
+    int irregular = pieces == NULL;
+
+    if (pieces != NULL) 
+    {
+        // Cut the file into pieces of about equal size that end after a newline
+        const char *begin = file.data;
+        const char *end = file.data + file.size;
+
+        for (size_t i = 0; i < chunks; i++) 
+        {
+            const char *cut = i + 1 < chunks ? file.data + file.size * (i + 1) / chunks : end;
+            if (cut < begin) cut = begin;
+
+            const char *newline = cut < end ? memchr(cut, '\n', (size_t)(end - cut)) : NULL;
+            cut = newline ? newline + 1 : end;
+
+            pieces[i].begin = begin;
+            pieces[i].end = cut;
+            begin = cut;
+        }
+
+        runTasks(pieces, sizeof(LoadChunk), chunks, parseChunk, threads);
+
+        for (size_t i = 0; i < chunks; i++) 
+        {
+            if (pieces[i].irregular) irregular = 1;
+        }
+    }
+
+    if (irregular) 
+    {
+        // Let the serial loader deal with whatever this file holds
+        for (size_t i = 0; pieces != NULL && i < chunks; i++) 
+        {
+            StudBlock *block = pieces[i].pool.blocks;
+            while (block != NULL) 
+            {
+                StudBlock *next = block->next;
+                free(block);
+                block = next;
+            }
+            free(pieces[i].records);
+        }
+        free(pieces);
+        if (mapped) unmapFile(&file);
+
+        loadListFromFile(list, filename);
+        sortStudList(list);
+        return;
+    }
+
+    size_t total = 0;
+    size_t *starts = malloc((chunks + 1) * sizeof(size_t));
+    if (starts == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < chunks; i++) 
+    {
+        starts[i] = pieces[i].offset = total;
+        total += pieces[i].count;
+    }
+    starts[chunks] = total;
+
+    stud **sorted = malloc((total ? total : 1) * sizeof(stud *));
+    stud **buffer = malloc((total ? total : 1) * sizeof(stud *));
+    if (sorted == NULL || buffer == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Sort every piece where it lands, then merge the sorted pieces
+    for (size_t i = 0; i < chunks; i++) 
+    {
+        pieces[i].sorted = sorted;
+        pieces[i].buffer = buffer;
+    }
+    runTasks(pieces, sizeof(LoadChunk), chunks, sortChunk, threads);
+    mergeAllRuns(sorted, buffer, starts, chunks, threads);
+
+    LinkTask *links = malloc((size_t)threads * sizeof(LinkTask));
+    unsigned char *surnameStarts = malloc(total ? total : 1);
+    if (links == NULL || surnameStarts == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < threads; i++) 
+    {
+        links[i].items = sorted;
+        links[i].count = total;
+        links[i].first = total * (size_t)i / (size_t)threads;
+        links[i].last = total * (size_t)(i + 1) / (size_t)threads;
+        links[i].surnameStarts = surnameStarts;
+        links[i].seed = list->order.seed ^ (0x9E3779B9u * (uint32_t)(i + 1));
+        if (links[i].seed == 0) links[i].seed = 1;
+    }
+    runTasks(links, sizeof(LinkTask), (size_t)threads, linkRange, threads);
+
+    // Hand the records over to the pool of the list
+    for (size_t i = 0; i < chunks; i++) 
+    {
+        StudBlock *block = pieces[i].pool.blocks;
+        while (block != NULL) 
+        {
+            StudBlock *next = block->next;
+            block->next = list->pool.blocks;
+            list->pool.blocks = block;
+            block = next;
+        }
+        list->pool.bytes += pieces[i].pool.bytes;
+        free(pieces[i].records);
+    }
+
+    if (total > 0) 
+    {
+        list->head = sorted[0];
+        list->tail = sorted[total - 1];
+    }
+    list->size = total;
+
+    // Only one surname index slot per distinct surname is left to fill
+    for (size_t i = 0; i < total; ) 
+    {
+        size_t end = i + 1;
+        while (end < total && !surnameStarts[end]) end++;
+        indexSurnameChain(list, sorted[i], sorted[end - 1], end - i);
+        i = end;
+    }
+
+    // Stitch the ordered index parts together in array order
+    OrderIndex *order = &list->order;
+    if (order->head == NULL) order->head = orderNewNode(NULL, ORDER_MAX_LEVEL);
+    orderClear(order);
+
+    for (int i = 0; i < threads; i++) 
+    {
+        if (links[i].firstNode[0] == NULL) continue;
+
+        links[i].firstNode[0]->prev = order->last[0];
+        for (int l = 0; l < links[i].level; l++) 
+        {
+            if (links[i].firstNode[l] == NULL) continue;
+            order->last[l]->next[l] = links[i].firstNode[l];
+            order->last[l] = links[i].lastNode[l];
+        }
+        if (links[i].level > order->level) order->level = links[i].level;
+    }
+    order->sorted = 1;
+    order->displaced = NULL;
+    buildScoreIndex(list);
+
+    // Every chain was built in list order
+    list->index.stale = 0;
+    list->columns.current = 0;
+
+    // The records were parsed in file order; lay them out in list order
+    relayoutList(list);
+
+    free(surnameStarts);
+    free(links);
+    free(sorted);
+    free(buffer);
+    free(starts);
+    free(pieces);
+    unmapFile(&file);
+}
+
+/**
+ * @brief Moves a fully written temporary file over the target file.
+ * @param tmpPath The name of the temporary file.
+ * @param filename The name of the target file.
+ * @return 1 on success, 0 on failure.
+ */
+static int replaceFile(const char *tmpPath, const char *filename) 
+{
+#ifdef _WIN32
+    // rename does not replace an existing file on Windows
+    remove(filename);
+#endif
+    if (rename(tmpPath, filename) != 0) 
+    {
+        perror("Error replacing file");
+        return 0;
+    }
+    return 1;
+}
+
+void saveListToFile(stud_List *list, const char *filename) 
+{
+    METRICS_START(started);
+
+    // Write to a temporary file first so a failed save keeps the old snapshot
+    char tmpPath[FILENAME_MAX];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", filename);
+
+    FILE *file = fopen(tmpPath, "w");
+
+    if (!file) 
+    {
+        perror("Error opening file for writing");
+        return;
+    }
+
+    stud *current = list->head;
+    while (current != NULL) 
+    {
+        fprintf(file, "%s %s %s %d %d\n",
+                current->surname, current->name, current->patronymic, current->age, current->average_score);
+        current = current->next;
+    }
+    METRICS_VALUE(long, written, ftell(file));
+
+    if (fclose(file) != 0) 
+    {
+        perror("Error writing file");
+        remove(tmpPath);
+        return;
+    }
+
+    replaceFile(tmpPath, filename);
+    METRICS_RECORD(METRIC_SAVE, started, list->size, written);
+}
+
+// Records written per fwrite call; an even count keeps chunks a multiple of eight bytes
+#define ROSTER_WRITE_CHUNK 4096
+
+/**
+ * @brief Fills a binary roster record from a student.
+ * @param record The record.
+ * @param student The student.
+ * @return void
+ */
+static void fillStudRecord(StudRecord *record, const stud *student) 
+{
+    // strncpy zero-fills the rest of each field, keeping files reproducible
+    strncpy(record->surname, student->surname, sizeof(record->surname));
+    strncpy(record->name, student->name, sizeof(record->name));
+    strncpy(record->patronymic, student->patronymic, sizeof(record->patronymic));
+    memset(record->reserved, 0, sizeof(record->reserved));
+    record->age = student->age;
+    record->average_score = student->average_score;
+}
+
+/**
+ * @brief Fills the header of a binary roster before its records are checksummed.
+ * @param header The header.
+ * @param count The number of records.
+ * @param generation The generation of the snapshot, 0 outside the journal.
+ * @return void
+ */
+static void initRosterHeader(RosterHeader *header, uint64_t count, uint64_t generation) 
+{
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, ROSTER_MAGIC, 8);
+    header->version = ROSTER_VERSION;
+    header->recordSize = sizeof(StudRecord);
+    header->count = count;
+    header->checksum = ROSTER_CHECKSUM_SEED;
+    header->generation = generation;
+}
+
+int saveListToBinaryFile(stud_List *list, const char *filename) 
+{
+    METRICS_START(started);
+
+    char tmpPath[FILENAME_MAX];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", filename);
+
+    FILE *file = fopen(tmpPath, "wb");
+
+    if (!file) 
+    {
+        perror("Error opening file for writing");
+        return 0;
+    }
+
+    StudRecord *chunk = malloc(ROSTER_WRITE_CHUNK * sizeof(StudRecord));
+    if (chunk == NULL) 
+    {
+        printf("Error allocating memory\n");
+        fclose(file);
+        remove(tmpPath);
+        return 0;
+    }
+
+    // The header is written again once the checksum is known
+    RosterHeader header;
+    initRosterHeader(&header, list->size, 0);
+
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    stud *current = list->head;
+    while (ok && current != NULL) 
+    {
+        size_t n = 0;
+        while (current != NULL && n < ROSTER_WRITE_CHUNK) 
+        {
+            fillStudRecord(&chunk[n++], current);
+            current = current->next;
+        }
+
+        header.checksum = rosterChecksum(header.checksum, chunk, n * sizeof(StudRecord));
+        ok = fwrite(chunk, sizeof(StudRecord), n, file) == n;
+    }
+    free(chunk);
+
+    if (ok) 
+    {
+        ok = fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    }
+
+    if (fclose(file) != 0 || !ok) 
+    {
+        perror("Error writing file");
+        remove(tmpPath);
+        return 0;
+    }
+
+    int replaced = replaceFile(tmpPath, filename);
+    METRICS_RECORD(METRIC_SAVE, started, list->size, sizeof(RosterHeader) + list->size * sizeof(StudRecord));
+    return replaced;
+}
+
+void saveRoster(stud_List *list, const char *filename, RosterFormat format) 
+{
+    if (format == ROSTER_BINARY) 
+    {
+        saveListToBinaryFile(list, filename);
+    } 
+    
+    else if (format == ROSTER_PACKED) 
+    {
+        saveListToPackedFile(list, filename);
+    } 
+    
+    else 
+    {
+        saveListToFile(list, filename);
+    }
+}
+
+// Bytes the packed writer collects before writing them out
+#define PACK_BUFFER_SIZE (1024 * 1024)
+
+// Longest encoded record: three dictionary numbers or new words, and two integers
+#define PACK_MAX_RECORD 96
+
+// Dictionary of one text field of the packed roster
+typedef struct 
+{
+    // Words zero-padded to the widest field, numbered in order of appearance
+    char (*words)[20];
+    uint32_t count;
+    uint32_t capacity;
+
+    // Word numbers plus one by hash, zero for an empty slot; only the writer uses them
+    uint32_t *slots;
+    size_t slotCount;
+
+    // Number of the word in the previous record
+    uint32_t last;
+    
+} PackDict;
+
+// Packed roster output, written out in pieces whose length is a multiple of eight
+// so the checksum can be chained
+typedef struct 
+{
+    FILE *file;
+    unsigned char *data;
+    size_t length;
+    uint64_t checksum;
+    int ok;
+    
+} PackWriter;
+
+/**
+ * @brief Maps a signed number to an unsigned one with small magnitudes kept small.
+ * @param value The number.
+ * @return The zigzag encoding of the number.
+ */
+static uint64_t zigzagEncode(int64_t value) 
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+/**
+ * @brief Reverses zigzagEncode.
+ * @param value The zigzag encoding.
+ * @return The signed number.
+ */
+static int64_t zigzagDecode(uint64_t value) 
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/**
+ * @brief Appends a variable-length integer, seven bits per byte, low bits first.
+ * @param writer The writer.
+ * @param value The number.
+ * @return void
+ */
+static void packVarint(PackWriter *writer, uint64_t value) 
+{
+    while (value >= 0x80) 
+    {
+        writer->data[writer->length++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    writer->data[writer->length++] = (unsigned char)value;
+}
+
+/**
+ * @brief Reads a variable-length integer.
+ * @param pos The current position, advanced past the number.
+ * @param end The end of the input.
+ * @param value Receives the number.
+ * @return 1 on success, 0 if the input ends inside the number or it is too long.
+ */
+static int unpackVarint(const unsigned char **pos, const unsigned char *end, uint64_t *value) 
+{
+    const unsigned char *p = *pos;
+    uint64_t result = 0;
+
+    for (int shift = 0; shift < 64 && p < end; shift += 7) 
+    {
+        unsigned char byte = *p++;
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (byte < 0x80) 
+        {
+            *value = result;
+            *pos = p;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes out the buffered bytes of a packed writer.
+ * @param writer The writer.
+ * @param all Non-zero to write everything, otherwise a multiple of eight bytes is written
+ *            and the rest kept.
+ * @return void
+ */
+static void packFlush(PackWriter *writer, int all) 
+{
+    size_t length = all ? writer->length : writer->length & ~(size_t)7;
+
+    writer->checksum = rosterChecksum(writer->checksum, writer->data, length);
+    if (fwrite(writer->data, 1, length, writer->file) != length) writer->ok = 0;
+
+    memmove(writer->data, writer->data + length, writer->length - length);
+    writer->length -= length;
+}
+
+/**
+ * @brief Makes room for more words in a dictionary and its hash table.
+ * @param dict The dictionary.
+ * @param hashed Non-zero if the hash table is kept as well.
+ * @return void
+ */
+static void growPackDict(PackDict *dict, int hashed) 
+{
+    dict->capacity = dict->capacity ? dict->capacity * 2 : 1024;
+    dict->words = realloc(dict->words, dict->capacity * sizeof(*dict->words));
+
+    if (dict->words == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (!hashed) return;
+
+    // The hash table keeps a load factor of at most one half
+    free(dict->slots);
+    dict->slotCount = (size_t)dict->capacity * 2;
+    dict->slots = calloc(dict->slotCount, sizeof(uint32_t));
+
+    if (dict->slots == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint32_t id = 0; id < dict->count; id++) 
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (const char *c = dict->words[id]; *c; c++) hash = (hash ^ (unsigned char)*c) * 1099511628211ULL;
+
+        size_t i = (size_t)hash & (dict->slotCount - 1);
+        while (dict->slots[i] != 0) i = (i + 1) & (dict->slotCount - 1);
+        dict->slots[i] = id + 1;
+    }
+}
+
+/**
+ * @brief Appends a word as the difference of its number from the previous one,
+ * spelling it out the first time it appears.
+ * @param writer The writer.
+ * @param dict The dictionary of the field.
+ * @param word The word.
+ * @return void
+ */
+static void packWord(PackWriter *writer, PackDict *dict, const char *word) 
+{
+    if (dict->count == dict->capacity) growPackDict(dict, 1);
+
+    uint64_t hash = 14695981039346656037ULL;
+    size_t length = 0;
+    for (; word[length]; length++) hash = (hash ^ (unsigned char)word[length]) * 1099511628211ULL;
+
+    size_t mask = dict->slotCount - 1;
+    size_t i = (size_t)hash & mask;
+    while (dict->slots[i] != 0 && strcmp(dict->words[dict->slots[i] - 1], word) != 0) i = (i + 1) & mask;
+
+    if (dict->slots[i] != 0) 
+    {
+        // Zero marks a new word, so known words are shifted up by one
+        uint32_t id = dict->slots[i] - 1;
+        packVarint(writer, zigzagEncode((int64_t)id - dict->last) + 1);
+        dict->last = id;
+        return;
+    }
+
+    uint32_t id = dict->count++;
+    memset(dict->words[id], 0, sizeof(dict->words[id]));
+    memcpy(dict->words[id], word, length);
+    dict->slots[i] = id + 1;
+    dict->last = id;
+
+    packVarint(writer, 0);
+    writer->data[writer->length++] = (unsigned char)length;
+    memcpy(writer->data + writer->length, word, length);
+    writer->length += length;
+}
+
+/**
+ * @brief Reads a word written by packWord.
+ * @param pos The current position, advanced past the word.
+ * @param end The end of the input.
+ * @param dict The dictionary of the field.
+ * @param dest Receives the word.
+ * @param width The size of dest; longer words are rejected.
+ * @return 1 on success, 0 if the input is malformed.
+ */
+static int unpackWord(const unsigned char **pos, const unsigned char *end, PackDict *dict, char *dest, size_t width) 
+{
+    uint64_t code;
+    if (!unpackVarint(pos, end, &code)) return 0;
+
+    uint32_t id;
+    if (code == 0) 
+    {
+        if (*pos == end) return 0;
+        size_t length = *(*pos)++;
+        if (length >= width || length > (size_t)(end - *pos)) return 0;
+
+        if (dict->count == dict->capacity) growPackDict(dict, 0);
+        id = dict->count++;
+        memset(dict->words[id], 0, sizeof(dict->words[id]));
+        memcpy(dict->words[id], *pos, length);
+        *pos += length;
+    } 
+    
+    else 
+    {
+        int64_t number = (int64_t)dict->last + zigzagDecode(code - 1);
+        if (number < 0 || number >= (int64_t)dict->count) return 0;
+        id = (uint32_t)number;
+    }
+
+    // Dictionary words are zero-padded, so the terminator comes along
+    memcpy(dest, dict->words[id], width);
+    dict->last = id;
+    return 1;
+}
+
+/**
+ * @brief Frees the memory of a dictionary.
+ * @param dict The dictionary.
+ * @return void
+ */
+static void freePackDict(PackDict *dict) 
+{
+    free(dict->words);
+    free(dict->slots);
+}
+
+/**
+ * @brief Writes a packed roster, header included, to an open file.
+ * @param file The file, positioned at its start.
+ * @param records The records.
+ * @param count The number of records.
+ * @return 1 on success, 0 on failure.
+ */
+static int writePackedRecords(FILE *file, const StudRecord *records, size_t count) 
+{
+    PackWriter writer = { file, malloc(PACK_BUFFER_SIZE), 0, ROSTER_CHECKSUM_SEED, 1 };
+    if (writer.data == NULL) 
+    {
+        printf("Error allocating memory\n");
+        return 0;
+    }
+
+    // The header is written again once the checksum is known
+    PackHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PACK_MAGIC, 8);
+    header.version = PACK_VERSION;
+    header.count = count;
+
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    PackDict surnames = { 0 }, names = { 0 }, patronymics = { 0 };
+    int32_t lastAge = 0;
+
+    for (size_t i = 0; ok && i < count; i++) 
+    {
+        const StudRecord *record = &records[i];
+
+        // Record fields are zero-filled but not terminated at full width
+        char surname[sizeof(record->surname) + 1], name[sizeof(record->name) + 1], patronymic[sizeof(record->patronymic) + 1];
+        memcpy(surname, record->surname, sizeof(record->surname));
+        memcpy(name, record->name, sizeof(record->name));
+        memcpy(patronymic, record->patronymic, sizeof(record->patronymic));
+        surname[sizeof(record->surname)] = name[sizeof(record->name)] = patronymic[sizeof(record->patronymic)] = '\0';
+
+        packWord(&writer, &surnames, surname);
+        packWord(&writer, &names, name);
+        packWord(&writer, &patronymics, patronymic);
+
+        // Ages are close together, so the difference from the previous one is stored
+        packVarint(&writer, zigzagEncode((int64_t)record->age - lastAge));
+        packVarint(&writer, zigzagEncode(record->average_score));
+        lastAge = record->age;
+
+        if (writer.length > PACK_BUFFER_SIZE - PACK_MAX_RECORD) packFlush(&writer, 0);
+        ok = writer.ok;
+    }
+
+    packFlush(&writer, 1);
+    ok = ok && writer.ok;
+    header.checksum = writer.checksum;
+
+    if (ok) 
+    {
+        ok = fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fseek(file, 0, SEEK_END) == 0;
+    }
+
+    freePackDict(&surnames);
+    freePackDict(&names);
+    freePackDict(&patronymics);
+    free(writer.data);
+    return ok;
+}
+
+static void loadPackedRecords(stud_List *list, const char *data, size_t size, const char *filename) 
+{
+    PackHeader header;
+    memcpy(&header, data, sizeof(header));
+
+    if (header.version != PACK_VERSION) 
+    {
+        fprintf(stderr, "%s: unsupported packed roster version\n", filename);
+        return;
+    }
+
+    const unsigned char *pos = (const unsigned char *)data + sizeof(header);
+    const unsigned char *end = (const unsigned char *)data + size;
+
+    if (rosterChecksum(ROSTER_CHECKSUM_SEED, pos, (size_t)(end - pos)) != header.checksum) 
+    {
+        fprintf(stderr, "%s: roster checksum mismatch\n", filename);
+        return;
+    }
+
+    PackDict surnames = { 0 }, names = { 0 }, patronymics = { 0 };
+    int64_t age = 0;
+
+    for (uint64_t i = 0; i < header.count; i++) 
+    {
+        stud *newStudent = allocStud(list);
+        if (!newStudent) 
+        {
+            perror("Memory allocation failed");
+            break;
+        }
+
+        uint64_t ageCode, scoreCode;
+        if (!unpackWord(&pos, end, &surnames, newStudent->surname, sizeof(newStudent->surname)) ||
+            !unpackWord(&pos, end, &names, newStudent->name, sizeof(newStudent->name)) ||
+            !unpackWord(&pos, end, &patronymics, newStudent->patronymic, sizeof(newStudent->patronymic)) ||
+            !unpackVarint(&pos, end, &ageCode) || !unpackVarint(&pos, end, &scoreCode)) 
+        {
+            fprintf(stderr, "%s: malformed packed record %llu\n", filename, (unsigned long long)i);
+            freeStud(list, newStudent);
+            break;
+        }
+
+        age += zigzagDecode(ageCode);
+        newStudent->age = (int)age;
+        newStudent->average_score = (int)zigzagDecode(scoreCode);
+
+        newStudent->next = NULL;
+        newStudent->prev = list->tail;
+
+        if (list->head == NULL) 
+        {
+            list->head = newStudent;
+        } 
+
+        else 
+        {
+            list->tail->next = newStudent;
+        }
+        list->tail = newStudent;
+
+        // The ordered index is built in one go once the whole file is read
+        indexStudentAt(list, newStudent, 0);
+        list->size++;
+    }
+
+    freePackDict(&surnames);
+    freePackDict(&names);
+    freePackDict(&patronymics);
+}
+
+// Roster frozen for writing: the records are a copy, so the list may change meanwhile
+typedef struct 
+{
+    StudRecord *records;
+    size_t count;
+    char path[FILENAME_MAX];
+    RosterFormat format;
+    uint64_t generation;
+
+    // Journal whose changes the snapshot holds, removed once it is written; empty for none
+    char foldedJournal[FILENAME_MAX];
+    
+} RosterSnapshot;
+
+#ifdef LIST_THREADS
+// Background snapshot writer: one snapshot is written while at most one more waits
+typedef struct 
+{
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int running;
+
+    RosterSnapshot *waiting;
+    RosterSnapshot *writing;
+    
+} SnapshotWriter;
+
+static SnapshotWriter snapshotWriter = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, NULL, NULL };
+#endif
+
+/**
+ * @brief Copies the students of a list into a snapshot.
+ * @param list A pointer to the student list.
+ * @param filename The name of the file the snapshot is written to.
+ * @param format The format of the file.
+ * @param generation The generation written into a binary header.
+ * @return The snapshot, or NULL if memory is exhausted.
+ */
+static RosterSnapshot *captureSnapshot(stud_List *list, const char *filename, RosterFormat format, uint64_t generation) 
+{
+    RosterSnapshot *snapshot = malloc(sizeof(RosterSnapshot));
+    StudRecord *records = malloc((list->size ? list->size : 1) * sizeof(StudRecord));
+
+    if (snapshot == NULL || records == NULL) 
+    {
+        printf("Error allocating memory\n");
+        free(snapshot);
+        free(records);
+        return NULL;
+    }
+
+    size_t n = 0;
+    for (stud *current = list->head; current != NULL; current = current->next) 
+    {
+        fillStudRecord(&records[n++], current);
+    }
+
+    snapshot->records = records;
+    snapshot->count = n;
+    snprintf(snapshot->path, sizeof(snapshot->path), "%s", filename);
+    snapshot->format = format;
+    snapshot->generation = generation;
+    snapshot->foldedJournal[0] = '\0';
+    return snapshot;
+}
+
+/**
+ * @brief Frees a snapshot.
+ * @param snapshot The snapshot.
+ * @return void
+ */
+static void freeSnapshot(RosterSnapshot *snapshot) 
+{
+    free(snapshot->records);
+    free(snapshot);
+}
+
+/**
+ * @brief Writes a snapshot to a temporary file, flushes it to disk and moves it into place.
+ * The journal it folds in is removed afterwards.
+ * @param snapshot The snapshot.
+ * @return 1 on success, 0 on failure.
+ */
+static int writeSnapshot(const RosterSnapshot *snapshot) 
+{
+    METRICS_START(started);
+
+    char tmpPath[sizeof(snapshot->path) + 4];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", snapshot->path);
+
+    FILE *file = fopen(tmpPath, snapshot->format == ROSTER_TEXT ? "w" : "wb");
+
+    if (!file) 
+    {
+        perror("Error opening file for writing");
+        return 0;
+    }
+
+    int ok = 1;
+    if (snapshot->format == ROSTER_BINARY) 
+    {
+        RosterHeader header;
+        initRosterHeader(&header, snapshot->count, snapshot->generation);
+        header.checksum = rosterChecksum(header.checksum, snapshot->records, snapshot->count * sizeof(StudRecord));
+
+        ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(snapshot->records, sizeof(StudRecord), snapshot->count, file) == snapshot->count;
+    } 
+    
+    else if (snapshot->format == ROSTER_PACKED) 
+    {
+        ok = writePackedRecords(file, snapshot->records, snapshot->count);
+    } 
+    
+    else 
+    {
+        for (size_t i = 0; i < snapshot->count; i++) 
+        {
+            const StudRecord *record = &snapshot->records[i];
+            fprintf(file, "%s %s %s %d %d\n",
+                    record->surname, record->name, record->patronymic, record->age, record->average_score);
+        }
+        ok = !ferror(file);
+    }
+    METRICS_VALUE(long, written, ftell(file));
+
+    // The data must be on disk before the rename makes it the snapshot
+    ok = fflush(file) == 0 && ok;
+#ifdef LIST_POSIX
+    ok = ok && fsync(fileno(file)) == 0;
+#endif
+
+    if (fclose(file) != 0 || !ok) 
+    {
+        perror("Error writing file");
+        remove(tmpPath);
+        return 0;
+    }
+
+    if (!replaceFile(tmpPath, snapshot->path)) return 0;
+    if (snapshot->foldedJournal[0] != '\0') remove(snapshot->foldedJournal);
+
+    METRICS_RECORD(METRIC_SAVE, started, snapshot->count, written);
+    return 1;
+}
+
+#ifdef LIST_THREADS
+/**
+ * @brief Writes the snapshots handed to the background writer, one after another.
+ * @param arg Unused.
+ * @return Never returns.
+ */
+static void *snapshotWriterRun(void *arg) 
+{
+    (void)arg;
+    SnapshotWriter *writer = &snapshotWriter;
+
+    pthread_mutex_lock(&writer->lock);
+    for (;;) 
+    {
+        while (writer->waiting == NULL) pthread_cond_wait(&writer->changed, &writer->lock);
+
+        writer->writing = writer->waiting;
+        writer->waiting = NULL;
+        pthread_cond_broadcast(&writer->changed);
+        pthread_mutex_unlock(&writer->lock);
+
+        // Only this thread changes the snapshot being written
+        writeSnapshot(writer->writing);
+
+        pthread_mutex_lock(&writer->lock);
+        freeSnapshot(writer->writing);
+        writer->writing = NULL;
+        pthread_cond_broadcast(&writer->changed);
+    }
+    return NULL;
+}
+#endif
+
+/**
+ * @brief Hands a snapshot to the background writer, which frees it once written.
+ * Without threads, or if the writer thread cannot be started, it is written at once.
+ * @param snapshot The snapshot.
+ * @return void
+ */
+static void submitSnapshot(RosterSnapshot *snapshot) 
+{
+#ifdef LIST_THREADS
+    SnapshotWriter *writer = &snapshotWriter;
+    pthread_mutex_lock(&writer->lock);
+
+    if (!writer->running) 
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, snapshotWriterRun, NULL) == 0) 
+        {
+            pthread_detach(thread);
+            writer->running = 1;
+        }
+    }
+
+    if (writer->running) 
+    {
+        // A newer snapshot of the same file makes a waiting one pointless
+        RosterSnapshot *waiting = writer->waiting;
+        if (waiting != NULL && waiting->foldedJournal[0] == '\0' && strcmp(waiting->path, snapshot->path) == 0) 
+        {
+            freeSnapshot(waiting);
+            writer->waiting = NULL;
+        }
+
+        while (writer->waiting != NULL) pthread_cond_wait(&writer->changed, &writer->lock);
+
+        writer->waiting = snapshot;
+        pthread_cond_broadcast(&writer->changed);
+        pthread_mutex_unlock(&writer->lock);
+        return;
+    }
+    pthread_mutex_unlock(&writer->lock);
+#endif
+
+    writeSnapshot(snapshot);
+    freeSnapshot(snapshot);
+}
+
+/**
+ * @brief Tells whether a snapshot of a file is waiting or being written.
+ * @param filename The name of the file.
+ * @return Non-zero if the background writer still has one.
+ */
+static int snapshotPending(const char *filename) 
+{
+    int pending = 0;
+#ifdef LIST_THREADS
+    SnapshotWriter *writer = &snapshotWriter;
+    pthread_mutex_lock(&writer->lock);
+    pending = (writer->waiting != NULL && strcmp(writer->waiting->path, filename) == 0) ||
+              (writer->writing != NULL && strcmp(writer->writing->path, filename) == 0);
+    pthread_mutex_unlock(&writer->lock);
+#else
+    (void)filename;
+#endif
+    return pending;
+}
+
+int saveListToPackedFile(stud_List *list, const char *filename) 
+{
+    // The encoder works on fixed-width records, so the list is copied first
+    RosterSnapshot *snapshot = captureSnapshot(list, filename, ROSTER_PACKED, 0);
+    if (snapshot == NULL) return 0;
+
+    int written = writeSnapshot(snapshot);
+    freeSnapshot(snapshot);
+    return written;
+}
+
+void saveRosterInBackground(stud_List *list, const char *filename, RosterFormat format) 
+{
+    RosterSnapshot *snapshot = captureSnapshot(list, filename, format, 0);
+    if (snapshot != NULL) submitSnapshot(snapshot);
+}
+
+void waitForBackgroundSaves(void) 
+{
+#ifdef LIST_THREADS
+    SnapshotWriter *writer = &snapshotWriter;
+    pthread_mutex_lock(&writer->lock);
+    while (writer->waiting != NULL || writer->writing != NULL) 
+    {
+        pthread_cond_wait(&writer->changed, &writer->lock);
+    }
+    pthread_mutex_unlock(&writer->lock);
+#endif
+}
+
+void printStudentsByPerformanceToFile(stud_List *list, const char *filename) 
+{
+    FILE *file = fopen(filename, "w");
+    if (!file) 
+    {
+        perror("Error opening file for writing");
+        return;
+    }
+
+    printStudentsByPerformanceHelper(list, file);
+
+    fclose(file);
+}
+
+void openWorkingCopy(stud_List *list) 
+{
+    // The binary roster is the working copy; students.txt is imported
+    // only when there is no binary roster yet
+    FILE *roster = fopen("students.bin", "rb");
+    if (roster) 
+    {
+        fclose(roster);
+        loadListFromFile(list, "students.bin");
+    } 
+    
+    else 
+    {
+        loadListFromFile(list, "students.txt");
+
+        // Changes made after an import that never reached a snapshot live
+        // only in the journals of the binary roster
+        replayJournal(list, "students.bin.journal.old", 0);
+        replayJournal(list, "students.bin.journal", 0);
+    }
+
+    // From now on changes are appended to students.bin.journal
+    journalOpen(list, "students.bin", ROSTER_BINARY);
+}
+
+// Smallest memory limit of the external sort
+#define EXTERNAL_MIN_MEMORY (1024 * 1024)
+
+// Most runs merged in one pass
+#define EXTERNAL_MAX_FANIN 64
+
+// Text file read in large pieces, keeping a partial word for the next piece
+typedef struct 
+{
+    FILE *file;
+    char *data;
+    size_t capacity;
+    size_t length;
+    size_t pos;
+
+    // Words end before this position unless the whole file has been read
+    size_t limit;
+    int eof;
+    
+} TextReader;
+
+// Sorted run of records spilled to a temporary file
+typedef struct 
+{
+    FILE *file;
+    uint64_t count;
+    
+} SortRun;
+
+// Buffered reader of one run during a merge
+typedef struct 
+{
+    FILE *file;
+    StudRecord *records;
+    size_t length;
+    size_t next;
+    uint64_t remaining;
+    
+} RunReader;
+
+// Records gathered for a run file so it is written in large pieces
+typedef struct 
+{
+    FILE *file;
+    StudRecord *records;
+    size_t capacity;
+    size_t length;
+    
+} RunWriter;
+
+/**
+ * @brief Reads the next piece of a text file behind the unparsed rest of the buffer.
+ * @param reader A pointer to the reader.
+ * @return 1 if more text is available, 0 otherwise.
+ */
+static int refillText(TextReader *reader) 
+{
+    if (reader->eof) return 0;
+
+    size_t rest = reader->length - reader->pos;
+
+    // A single word filling the whole buffer cannot be a field
+    if (rest == reader->capacity) return 0;
+
+    memmove(reader->data, reader->data + reader->pos, rest);
+    reader->length = rest;
+    reader->pos = 0;
+
+    size_t got = fread(reader->data + rest, 1, reader->capacity - rest, reader->file);
+    reader->length += got;
+    if (got == 0 || reader->length < reader->capacity) reader->eof = feof(reader->file) || ferror(reader->file);
+
+    // Stop before a word that may continue in the next piece
+    reader->limit = reader->length;
+    if (!reader->eof) 
+    {
+        while (reader->limit > 0 && !isScanSpace(reader->data[reader->limit - 1])) reader->limit--;
+    }
+    return 1;
+}
+
+/**
+ * @brief Reads one record from a text file like loadListFromFile does.
+ * @param reader A pointer to the reader.
+ * @param record Receives the record.
+ * @return 1 if a record was read, 0 at the end of the input or at a malformed record.
+ */
+static int readTextRecord(TextReader *reader, StudRecord *record) 
+{
+    memset(record, 0, sizeof(*record));
+
+    for (;;) 
+    {
+        const char *pos = reader->data + reader->pos;
+        const char *limit = reader->data + reader->limit;
+        int age, score;
+
+        if (scanWord(&pos, limit, record->surname, sizeof(record->surname) - 1) &&
+            scanWord(&pos, limit, record->name, sizeof(record->name) - 1) &&
+            scanWord(&pos, limit, record->patronymic, sizeof(record->patronymic) - 1) &&
+            scanInt(&pos, limit, &age) &&
+            scanInt(&pos, limit, &score)) 
+        {
+            record->age = age;
+            record->average_score = score;
+            reader->pos = (size_t)(pos - reader->data);
+            return 1;
+        }
+
+        // Running into the limit only means the record continues in the next piece
+        if (pos < limit || !refillText(reader)) return 0;
+    }
+}
+
+/**
+ * @brief Compares two records by surname and then by name.
+ * @param a The first record.
+ * @param b The second record.
+ * @return A negative value, zero or a positive value, like strcmp.
+ */
+static int compareRecords(const StudRecord *a, const StudRecord *b) 
+{
+    int result = strcmp(a->surname, b->surname);
+    if (result != 0) return result;
+
+    return strcmp(a->name, b->name);
+}
+
+/**
+ * @brief Sorts an array of records by surname and name with a stable bottom-up merge sort.
+ * @param items The records to sort.
+ * @param buffer Scratch space for as many records.
+ * @param count The number of records.
+ * @return void
+ */
+static void sortRecordArray(StudRecord **items, StudRecord **buffer, size_t count) 
+{
+    StudRecord **from = items;
+    StudRecord **to = buffer;
+
+    for (size_t width = 1; width < count; width *= 2) 
+    {
+        for (size_t left = 0; left < count; left += 2 * width) 
+        {
+            size_t middle = left + width < count ? left + width : count;
+            size_t right = left + 2 * width < count ? left + 2 * width : count;
+            size_t i = left, j = middle, k = left;
+
+            while (i < middle && j < right) 
+            {
+                to[k++] = compareRecords(from[i], from[j]) <= 0 ? from[i++] : from[j++];
+            }
+            while (i < middle) to[k++] = from[i++];
+            while (j < right) to[k++] = from[j++];
+        }
+
+        StudRecord **swap = from;
+        from = to;
+        to = swap;
+    }
+
+    if (from != items) memcpy(items, from, count * sizeof(StudRecord *));
+}
+
+/**
+ * @brief Writes a record as a line of the text roster format.
+ * @param file The file to write to.
+ * @param record The record.
+ * @return void
+ */
+static void writeTextRecord(FILE *file, const StudRecord *record) 
+{
+    fprintf(file, "%s %s %s %d %d\n",
+            record->surname, record->name, record->patronymic, (int)record->age, (int)record->average_score);
+}
+
+/**
+ * @brief Tells whether the head of one run reader goes before the head of another.
+ * @param readers The run readers.
+ * @param a The first reader.
+ * @param b The second reader.
+ * @return Non-zero if a goes first; equal records go in run order.
+ */
+static int runHeadBefore(const RunReader *readers, size_t a, size_t b) 
+{
+    int result = compareRecords(&readers[a].records[readers[a].next], &readers[b].records[readers[b].next]);
+    return result < 0 || (result == 0 && a < b);
+}
+
+/**
+ * @brief Moves a heap entry down to its place.
+ * @param heap The heap of reader numbers.
+ * @param size The number of entries.
+ * @param readers The run readers.
+ * @param i The entry to move.
+ * @return void
+ */
+static void siftRunHeap(size_t *heap, size_t size, const RunReader *readers, size_t i) 
+{
+    for (;;) 
+    {
+        size_t smallest = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+
+        if (left < size && runHeadBefore(readers, heap[left], heap[smallest])) smallest = left;
+        if (right < size && runHeadBefore(readers, heap[right], heap[smallest])) smallest = right;
+        if (smallest == i) return;
+
+        size_t swap = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = swap;
+        i = smallest;
+    }
+}
+
+/**
+ * @brief Refills the buffer of a run reader.
+ * @param reader A pointer to the reader.
+ * @param capacity The buffer size in records.
+ * @return 1 if records are available, 0 at the end of the run or on a read error.
+ */
+static int refillRun(RunReader *reader, size_t capacity) 
+{
+    size_t wanted = reader->remaining < capacity ? (size_t)reader->remaining : capacity;
+    if (wanted == 0) return 0;
+
+    reader->length = fread(reader->records, sizeof(StudRecord), wanted, reader->file);
+    reader->next = 0;
+    reader->remaining -= reader->length;
+    return reader->length > 0;
+}
+
+/**
+ * @brief Writes the records gathered by a run writer to its file.
+ * @param writer A pointer to the writer.
+ * @return 1 on success, 0 on a write error.
+ */
+static int flushRun(RunWriter *writer) 
+{
+    size_t length = writer->length;
+    writer->length = 0;
+    return fwrite(writer->records, sizeof(StudRecord), length, writer->file) == length;
+}
+
+/**
+ * @brief Adds a record to a run writer, writing the gathered records once it is full.
+ * @param writer A pointer to the writer.
+ * @param record The record.
+ * @return 1 on success, 0 on a write error.
+ */
+static int writeRunRecord(RunWriter *writer, const StudRecord *record) 
+{
+    writer->records[writer->length++] = *record;
+    return writer->length < writer->capacity || flushRun(writer);
+}
+
+/**
+ * @brief Merges sorted runs into a run file or into the text output.
+ * The run files are closed afterwards and their pointers cleared.
+ * @param runs The runs, in input order.
+ * @param count The number of runs.
+ * @param memoryLimit The memory available for the read and write buffers.
+ * @param out The file to write to; text output should already have a stdio
+ *            buffer of memoryLimit / (count + 1) bytes.
+ * @param text Non-zero to write text lines, zero to write records.
+ * @param written Receives the number of records written.
+ * @return 1 on success, 0 on failure.
+ */
+static int mergeSortedRuns(SortRun *runs, size_t count, size_t memoryLimit, FILE *out, int text, uint64_t *written) 
+{
+    // The output gets a buffer as large as every input; for text it is the
+    // stdio buffer of the output file
+    size_t capacity = memoryLimit / ((count + 1) * sizeof(StudRecord));
+    if (capacity < 64) capacity = 64;
+
+    RunReader *readers = calloc(count, sizeof(RunReader));
+    size_t *heap = malloc(count * sizeof(size_t));
+    StudRecord *records = malloc((text ? count : count + 1) * capacity * sizeof(StudRecord));
+    int ok = readers != NULL && heap != NULL && records != NULL;
+
+    RunWriter writer = { out, records + count * capacity, capacity, 0 };
+
+    size_t size = 0;
+    for (size_t i = 0; ok && i < count; i++) 
+    {
+        readers[i].file = runs[i].file;
+        readers[i].records = records + i * capacity;
+        readers[i].remaining = runs[i].count;
+
+        rewind(runs[i].file);
+        if (refillRun(&readers[i], capacity)) heap[size++] = i;
+    }
+
+    for (size_t i = size / 2; ok && i-- > 0; ) 
+    {
+        siftRunHeap(heap, size, readers, i);
+    }
+
+    *written = 0;
+    while (ok && size > 0) 
+    {
+        RunReader *reader = &readers[heap[0]];
+        const StudRecord *record = &reader->records[reader->next++];
+
+        if (text) writeTextRecord(out, record);
+        else if (!writeRunRecord(&writer, record)) ok = 0;
+        (*written)++;
+
+        // An exhausted run leaves the heap
+        if (reader->next == reader->length && !refillRun(reader, capacity)) 
+        {
+            heap[0] = heap[--size];
+        }
+        siftRunHeap(heap, size, readers, 0);
+    }
+
+    if (ok && !text && !flushRun(&writer)) ok = 0;
+
+    for (size_t i = 0; i < count; i++) 
+    {
+        if (ferror(runs[i].file)) ok = 0;
+        fclose(runs[i].file);
+        runs[i].file = NULL;
+    }
+
+    free(readers);
+    free(heap);
+    free(records);
+    return ok && !ferror(out);
+}
+
+int externalSortFile(const char *input, const char *output, size_t memoryLimit, uint64_t *count) 
+{
+    if (memoryLimit < EXTERNAL_MIN_MEMORY) memoryLimit = EXTERNAL_MIN_MEMORY;
+
+    FILE *file = fopen(input, "rb");
+    if (!file) 
+    {
+        perror("Error opening file for reading");
+        return 0;
+    }
+
+    // A sixteenth of the memory reads the input, another one gathers the sorted
+    // run for writing, the rest holds a run
+    TextReader reader = { file, NULL, memoryLimit / 16, 0, 0, 0, 0 };
+    RunWriter writer = { NULL, NULL, memoryLimit / 16 / sizeof(StudRecord), 0 };
+    size_t runCapacity = (memoryLimit - 2 * reader.capacity) / (sizeof(StudRecord) + 2 * sizeof(StudRecord *));
+
+    reader.data = malloc(reader.capacity);
+    writer.records = malloc(writer.capacity * sizeof(StudRecord));
+    StudRecord *records = malloc(runCapacity * sizeof(StudRecord));
+    StudRecord **sorted = malloc(runCapacity * sizeof(StudRecord *));
+    StudRecord **buffer = malloc(runCapacity * sizeof(StudRecord *));
+
+    SortRun *runs = NULL;
+    size_t runCount = 0;
+    size_t runsAllocated = 0;
+    uint64_t total = 0;
+    int ok = reader.data != NULL && writer.records != NULL && records != NULL && sorted != NULL && buffer != NULL;
+    int more = 1;
+
+    // Pass 1: sorted runs of as many records as fit in memory
+    while (ok && more) 
+    {
+        size_t length = 0;
+        while (length < runCapacity && (more = readTextRecord(&reader, &records[length])) != 0) 
+        {
+            sorted[length] = &records[length];
+            length++;
+        }
+        if (length == 0) break;
+
+        sortRecordArray(sorted, buffer, length);
+
+        if (runCount == runsAllocated) 
+        {
+            runsAllocated = runsAllocated ? runsAllocated * 2 : 16;
+            SortRun *grown = realloc(runs, runsAllocated * sizeof(SortRun));
+            if (grown == NULL) 
+            {
+                ok = 0;
+                break;
+            }
+            runs = grown;
+        }
+
+        FILE *spill = tmpfile();
+        if (spill == NULL) 
+        {
+            perror("Error creating temporary file");
+            ok = 0;
+            break;
+        }
+
+        writer.file = spill;
+        for (size_t i = 0; i < length && ok; i++) 
+        {
+            ok = writeRunRecord(&writer, sorted[i]);
+        }
+        if (!ok || !flushRun(&writer) || fflush(spill) != 0) 
+        {
+            perror("Error writing temporary file");
+            fclose(spill);
+            ok = 0;
+            break;
+        }
+
+        runs[runCount].file = spill;
+        runs[runCount].count = length;
+        runCount++;
+        total += length;
+    }
+
+    fclose(file);
+    free(reader.data);
+    free(writer.records);
+    free(records);
+    free(sorted);
+    free(buffer);
+
+    // Pass 2 and on: merge groups of runs until one pass can produce the output
+    size_t fanIn = memoryLimit / (64 * sizeof(StudRecord));
+    if (fanIn > EXTERNAL_MAX_FANIN) fanIn = EXTERNAL_MAX_FANIN;
+    if (fanIn < 2) fanIn = 2;
+
+    while (ok && runCount > fanIn) 
+    {
+        size_t merged = 0;
+        for (size_t first = 0; first < runCount; first += fanIn) 
+        {
+            size_t group = runCount - first < fanIn ? runCount - first : fanIn;
+            FILE *spill = group > 1 ? tmpfile() : NULL;
+            uint64_t written;
+
+            if (group == 1) 
+            {
+                // A last run without partners moves on as it is
+                SortRun single = runs[first];
+                runs[first].file = NULL;
+                runs[merged++] = single;
+                continue;
+            }
+            if (spill == NULL) 
+            {
+                perror("Error creating temporary file");
+                ok = 0;
+                break;
+            }
+            if (!mergeSortedRuns(runs + first, group, memoryLimit, spill, 0, &written) || fflush(spill) != 0) 
+            {
+                perror("Error writing temporary file");
+                fclose(spill);
+                ok = 0;
+                break;
+            }
+
+            runs[merged].file = spill;
+            runs[merged].count = written;
+            merged++;
+        }
+        if (!ok) break;
+        runCount = merged;
+    }
+
+    char tmpPath[FILENAME_MAX];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", output);
+
+    FILE *out = ok ? fopen(tmpPath, "w") : NULL;
+    if (ok && out == NULL) 
+    {
+        perror("Error opening file for writing");
+        ok = 0;
+    }
+
+    // The lines are written through a buffer as large as the read buffer of a run
+    size_t outSize = memoryLimit / (runCount + 1);
+    char *outBuffer = ok ? malloc(outSize) : NULL;
+    if (outBuffer != NULL) setvbuf(out, outBuffer, _IOFBF, outSize);
+
+    if (ok) 
+    {
+        uint64_t written = 0;
+        ok = runCount == 0 || mergeSortedRuns(runs, runCount, memoryLimit, out, 1, &written);
+        runCount = 0;
+
+        if (fclose(out) != 0) ok = 0;
+        free(outBuffer);
+        if (!ok) 
+        {
+            perror("Error writing file");
+            remove(tmpPath);
+        } 
+        
+        else 
+        {
+            ok = replaceFile(tmpPath, output);
+        }
+    }
+
+    // Runs left over after a failure; merged runs are already closed
+    for (size_t i = 0; i < runCount; i++) 
+    {
+        if (runs[i].file != NULL) fclose(runs[i].file);
+    }
+    free(runs);
+
+    if (count != NULL) *count = total;
+    return ok;
+}
+
+/**
+ * @brief Reads the generation from the header of a binary roster.
+ * @param filename The name of the roster file.
+ * @return The generation, 0 for text and version 1 files or if the file cannot be read.
+ */
+static uint64_t rosterGeneration(const char *filename) 
+{
+    RosterHeader header;
+    memset(&header, 0, sizeof(header));
+
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) return 0;
+
+    size_t length = fread(&header, 1, sizeof(header), file);
+    fclose(file);
+
+    if (length < sizeof(header) || memcmp(header.magic, ROSTER_MAGIC, 8) != 0 || header.version < 2) return 0;
+    return header.generation;
+}
+
+/**
+ * @brief Starts an empty journal file that names the generation it applies to.
+ * @param journal The journal, whose file is closed if open.
+ * @return void
+ */
+static void journalRestart(Journal *journal) 
+{
+    if (journal->file) fclose(journal->file);
+    journal->records = 0;
+
+    journal->file = fopen(journal->path, "w");
+    if (journal->file == NULL) 
+    {
+        perror("Error opening journal");
+        return;
+    }
+
+    fprintf(journal->file, "G %llu\n", (unsigned long long)journal->generation);
+    fflush(journal->file);
+}
+
+int journalOpen(stud_List *list, const char *snapshotPath, RosterFormat format) 
+{
+    Journal *journal = malloc(sizeof(Journal));
+    if (journal == NULL) 
+    {
+        printf("Error allocating memory\n");
+        return 0;
+    }
+
+    snprintf(journal->snapshotPath, sizeof(journal->snapshotPath), "%s", snapshotPath);
+    snprintf(journal->path, sizeof(journal->path), "%s.journal", snapshotPath);
+    snprintf(journal->oldPath, sizeof(journal->oldPath), "%s.journal.old", snapshotPath);
+    journal->format = format;
+    journal->records = 0;
+    journal->generation = rosterGeneration(snapshotPath);
+
+    // Count the records left over from a previous session so compaction still triggers;
+    // a journal started for a snapshot that was never written carries on its generation
+    FILE *existing = fopen(journal->path, "r");
+    if (existing) 
+    {
+        unsigned long long logged;
+        int named = fscanf(existing, "G %llu", &logged) == 1;
+        if (named && logged > journal->generation) 
+        {
+            journal->generation = logged;
+        }
+        rewind(existing);
+
+        int c;
+        while ((c = fgetc(existing)) != EOF) 
+        {
+            if (c == '\n') journal->records++;
+        }
+        fclose(existing);
+
+        // The generation line is not a change
+        if (named && journal->records > 0) journal->records--;
+    }
+
+    journal->file = fopen(journal->path, "a");
+    if (journal->file == NULL) 
+    {
+        perror("Error opening journal");
+        free(journal);
+        return 0;
+    }
+
+    if (fseek(journal->file, 0, SEEK_END) == 0 && ftell(journal->file) == 0) 
+    {
+        fprintf(journal->file, "G %llu\n", (unsigned long long)journal->generation);
+        fflush(journal->file);
+    }
+
+    list->journal = journal;
+
+    // A background snapshot was cut short: fold both journals into a new one now
+    FILE *old = fopen(journal->oldPath, "r");
+    if (old != NULL) 
+    {
+        fclose(old);
+        journalCompact(list);
+    }
+    return 1;
+}
+
+void journalCompact(stud_List *list) 
+{
+    Journal *journal = list->journal;
+    if (journal == NULL) return;
+
+    // A background snapshot must not land after this one
+    waitForBackgroundSaves();
+
+    RosterSnapshot *snapshot = captureSnapshot(list, journal->snapshotPath, journal->format, journal->generation + 1);
+    if (snapshot == NULL) return;
+
+    // The snapshot must be complete before the journal is emptied
+    int written = writeSnapshot(snapshot);
+    freeSnapshot(snapshot);
+    if (!written) return;
+
+    // Both journals are older than the new snapshot now, so a crash before
+    // they are cleared cannot replay them twice
+    journal->generation++;
+    remove(journal->oldPath);
+    journalRestart(journal);
+}
+
+void journalCompactInBackground(stud_List *list) 
+{
+    Journal *journal = list->journal;
+    if (journal == NULL) return;
+
+    // Changes made meanwhile are folded in by the next compaction
+    if (snapshotPending(journal->snapshotPath)) return;
+
+    // An old journal still around means its snapshot failed; only a full save clears it
+    FILE *old = fopen(journal->oldPath, "r");
+    if (old != NULL) 
+    {
+        fclose(old);
+        journalCompact(list);
+        return;
+    }
+
+    RosterSnapshot *snapshot = captureSnapshot(list, journal->snapshotPath, journal->format, journal->generation + 1);
+    if (snapshot == NULL) return;
+
+    // The current journal stays on disk until the snapshot holding its changes does;
+    // changes from now on go to a fresh journal for the new snapshot
+    fclose(journal->file);
+    journal->file = NULL;
+
+    if (rename(journal->path, journal->oldPath) != 0) 
+    {
+        perror("Error rotating journal");
+        journal->file = fopen(journal->path, "a");
+        freeSnapshot(snapshot);
+        return;
+    }
+
+    snprintf(snapshot->foldedJournal, sizeof(snapshot->foldedJournal), "%s", journal->oldPath);
+    journal->generation++;
+    journalRestart(journal);
+
+    submitSnapshot(snapshot);
+}
+
+void journalClose(stud_List *list) 
+{
+    Journal *journal = list->journal;
+    if (journal == NULL) return;
+
+    // A background snapshot removes the old journal once it is on disk
+    waitForBackgroundSaves();
+
+    // Nothing to fold in when the snapshot already holds every change, as after
+    // a batch that compacted on its own
+    FILE *old = fopen(journal->oldPath, "r");
+    FILE *snapshot = fopen(journal->snapshotPath, "rb");
+    int current = journal->records == 0 && old == NULL && snapshot != NULL;
+    if (old) fclose(old);
+    if (snapshot) fclose(snapshot);
+
+    if (!current) journalCompact(list);
+
+    if (journal->file) fclose(journal->file);
+    free(journal);
+    list->journal = NULL;
+}
+
+size_t replayJournal(stud_List *list, const char *journalPath, uint64_t generation) 
+{
+    FILE *file = fopen(journalPath, "r");
+
+    // No journal means nothing changed since the snapshot
+    if (!file) return 0;
+
+    // Replayed changes are already in the journal, do not record them again
+    Journal *journal = list->journal;
+    list->journal = NULL;
+
+    char line[256];
+    char after[20];
+    stud data;
+    size_t applied = 0;
+    int sortPending = 0;
+    int stale = 0;
+
+    while (!stale && fgets(line, sizeof(line), file)) 
+    {
+        switch (line[0]) 
+        {
+            case 'G': {
+                // The journal was written for this snapshot or a newer one, unless
+                // the snapshot already holds its changes
+                unsigned long long logged;
+                if (sscanf(line + 1, "%llu", &logged) == 1 && logged < generation) stale = 1;
+                break;
+            }
+            case 'B':
+            case 'E':
+                if (sscanf(line + 1, "%19s %9s %19s %d %d",
+                           data.surname, data.name, data.patronymic, &data.age, &data.average_score) != 5) break;
+
+                if (line[0] == 'B') pushStudBeg(list, &data);
+                else pushStudEnd(list, &data);
+                applied++;
+                break;
+            case 'A':
+                if (sscanf(line + 1, "%19s %19s %9s %19s %d %d",
+                           after, data.surname, data.name, data.patronymic, &data.age, &data.average_score) != 6) break;
+
+                // The position depends on the order, so apply a pending sort first
+                if (sortPending) 
+                {
+                    sortStudList(list);
+                    sortPending = 0;
+                }
+
+                if (findSurnameSlot(list, after) != NULL) 
+                {
+                    stud *copy = malloc(sizeof(stud));
+                    if (copy == NULL) 
+                    {
+                        fprintf(stderr, "Memory allocation failed.\n");
+                        exit(EXIT_FAILURE);
+                    }
+                    *copy = data;
+                    addStudentAfter(list, after, copy);
+                    free(copy);
+                    applied++;
+                }
+                break;
+            case 'D': {
+                if (sscanf(line + 1, "%19s %9s %19s %d %d",
+                           data.surname, data.name, data.patronymic, &data.age, &data.average_score) != 5) break;
+
+                // Remove the first student matching every field
+                SurnameSlot *slot = findSurnameSlot(list, data.surname);
+                stud *current = slot ? slot->first : NULL;
+                while (current != NULL && 
+                       (strcmp(current->name, data.name) != 0 || strcmp(current->patronymic, data.patronymic) != 0 ||
+                        current->age != data.age || current->average_score != data.average_score)) 
+                {
+                    current = current->nextSame;
+                }
+
+                if (current != NULL) 
+                {
+                    removeStudent(list, current);
+                    applied++;
+                }
+                break;
+            }
+            case 'S':
+                // Consecutive adds and sorts need only one sort at the end
+                sortPending = 1;
+                applied++;
+                break;
+        }
+    }
+
+    if (sortPending) sortStudList(list);
+
+    fclose(file);
+    list->journal = journal;
+    return applied;
+}
+
+// Statistics collected for one band of the report
+typedef struct 
+{
+    size_t count;
+    int minScore;
+    int maxScore;
+    long long sum;
+    
+} BandStats;
+
+void columnsPrintSelectionByBands(const StudColumns *columns, const uint64_t *bitmap, FILE *output, const PerfBand *bands, size_t bandCount) 
+{
+    if (columns->count == 0) 
+    {
+        fprintf(output, "The list is empty.\n");
+        return;
+    }
+
+    size_t count = columns->count;
+    uint8_t *bandOf = malloc(count);
+    BandStats *collected = calloc(bandCount ? bandCount : 1, sizeof(BandStats));
+    if (bandOf == NULL || collected == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Sequential scan of the score column: band of every row and band statistics
+    for (size_t row = 0; row < count; row++) 
+    {
+        int score = columns->average_score[row];
+        bandOf[row] = UINT8_MAX;
+
+        // Rows outside the selection belong to no band
+        if (!(bitmap[row / 64] >> (row % 64) & 1)) continue;
+
+        for (size_t b = 0; b < bandCount && b < UINT8_MAX; b++) 
+        {
+            if (score < bands[b].minScore || score > bands[b].maxScore) continue;
+
+            BandStats *band = &collected[b];
+            if (band->count == 0 || score < band->minScore) band->minScore = score;
+            if (band->count == 0 || score > band->maxScore) band->maxScore = score;
+            band->sum += score;
+            band->count++;
+            bandOf[row] = (uint8_t)b;
+            break;
+        }
+    }
+
+    OutBuf out;
+    outInit(&out, output);
+
+    for (size_t b = 0; b < bandCount; b++) 
+    {
+        BandStats *band = &collected[b];
+
+        outPrintf(&out, "\n%s (%d-%d):\n", bands[b].title, bands[b].minScore, bands[b].maxScore);
+
+        if (band->count == 0) 
+        {
+            outPrintf(&out, "No students found\n");
+            continue;
+        }
+
+        // Rows of the band in list order; only the one-byte band column is scanned
+        for (size_t r = 0; r < count; r++) 
+        {
+            if (bandOf[r] != b) continue;
+
+            outStudentRow(&out, columns->student[r]);
+        }
+
+        outPrintf(&out, "Count: %zu, min: %d, max: %d, mean: %.2f\n",
+                  band->count, band->minScore, band->maxScore, (double)band->sum / (double)band->count);
+    }
+
+    outFree(&out);
+    free(collected);
+    free(bandOf);
+}
+
+/**
+ * @brief Scalar filter kernel for a range of rows.
+ * @param columns A pointer to the store.
+ * @param query The filter to apply.
+ * @param bitmap The selection bitmap; bits of the range must be clear.
+ * @param start The first row, a multiple of eight.
+ * @param end One past the last row.
+ * @return void
+ */
+static void filterRowsScalar(const StudColumns *columns, const StudQuery *query, uint64_t *bitmap, size_t start, size_t end) 
+{
+    for (size_t row = start; row < end; row++) 
+    {
+        int32_t age = columns->age[row];
+        int32_t score = columns->average_score[row];
+
+        if (age >= query->minAge && age <= query->maxAge && score >= query->minScore && score <= query->maxScore) 
+        {
+            bitmap[row / 64] |= (uint64_t)1 << (row % 64);
+        }
+    }
+}
+
+#ifdef LIST_X86_SIMD
+/**
+ * @brief AVX2 filter kernel, eight rows per step.
+ * @param columns A pointer to the store.
+ * @param query The filter to apply.
+ * @param bitmap The selection bitmap.
+ * @param count The number of rows.
+ * @return The first row left for the scalar kernel.
+ */
+__attribute__((target("avx2")))
+static size_t filterRowsAvx2(const StudColumns *columns, const StudQuery *query, uint64_t *bitmap, size_t count) 
+{
+    const __m256i minAge = _mm256_set1_epi32(query->minAge);
+    const __m256i maxAge = _mm256_set1_epi32(query->maxAge);
+    const __m256i minScore = _mm256_set1_epi32(query->minScore);
+    const __m256i maxScore = _mm256_set1_epi32(query->maxScore);
+    uint8_t *bytes = (uint8_t *)bitmap;
+
+    size_t row = 0;
+    for (; row + 8 <= count; row += 8) 
+    {
+        __m256i age = _mm256_loadu_si256((const __m256i *)(columns->age + row));
+        __m256i score = _mm256_loadu_si256((const __m256i *)(columns->average_score + row));
+
+        // A lane fails if it is below the minimum or above the maximum of either range
+        __m256i fail = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpgt_epi32(minAge, age), _mm256_cmpgt_epi32(age, maxAge)),
+            _mm256_or_si256(_mm256_cmpgt_epi32(minScore, score), _mm256_cmpgt_epi32(score, maxScore)));
+
+        // Eight rows starting at a multiple of eight fill exactly one bitmap byte
+        bytes[row / 8] = (uint8_t)(~_mm256_movemask_ps(_mm256_castsi256_ps(fail)) & 0xFF);
+    }
+
+    return row;
+}
+
+/**
+ * @brief SSE2 filter kernel, eight rows per step in two halves.
+ * @param columns A pointer to the store.
+ * @param query The filter to apply.
+ * @param bitmap The selection bitmap.
+ * @param count The number of rows.
+ * @return The first row left for the scalar kernel.
+ */
+__attribute__((target("sse2")))
+static size_t filterRowsSse2(const StudColumns *columns, const StudQuery *query, uint64_t *bitmap, size_t count) 
+{
+    const __m128i minAge = _mm_set1_epi32(query->minAge);
+    const __m128i maxAge = _mm_set1_epi32(query->maxAge);
+    const __m128i minScore = _mm_set1_epi32(query->minScore);
+    const __m128i maxScore = _mm_set1_epi32(query->maxScore);
+    uint8_t *bytes = (uint8_t *)bitmap;
+
+    size_t row = 0;
+    for (; row + 8 <= count; row += 8) 
+    {
+        int bits = 0;
+
+        for (int half = 0; half < 2; half++) 
+        {
+            __m128i age = _mm_loadu_si128((const __m128i *)(columns->age + row + 4 * half));
+            __m128i score = _mm_loadu_si128((const __m128i *)(columns->average_score + row + 4 * half));
+
+            __m128i fail = _mm_or_si128(
+                _mm_or_si128(_mm_cmpgt_epi32(minAge, age), _mm_cmpgt_epi32(age, maxAge)),
+                _mm_or_si128(_mm_cmpgt_epi32(minScore, score), _mm_cmpgt_epi32(score, maxScore)));
+
+            bits |= (~_mm_movemask_ps(_mm_castsi128_ps(fail)) & 0xF) << (4 * half);
+        }
+
+        bytes[row / 8] = (uint8_t)bits;
+    }
+
+    return row;
+}
+#endif
+
+size_t filterColumns(const StudColumns *columns, const StudQuery *query, uint64_t *bitmap) 
+{
+    size_t count = columns->count;
+    size_t words = (count + 63) / 64;
+    memset(bitmap, 0, words * sizeof(*bitmap));
+
+    size_t row = 0;
+
+#ifdef LIST_X86_SIMD
+    // The byte-wise bitmap stores of the kernels assume a little-endian layout, as on x86
+    if (__builtin_cpu_supports("avx2")) 
+    {
+        row = filterRowsAvx2(columns, query, bitmap, count);
+    } 
+    
+    else if (__builtin_cpu_supports("sse2")) 
+    {
+        row = filterRowsSse2(columns, query, bitmap, count);
+    }
+#endif
+
+    filterRowsScalar(columns, query, bitmap, row, count);
+
+    size_t matches = 0;
+    for (size_t w = 0; w < words; w++) 
+    {
+        bitmap[w] &= columns->live[w];
+#ifdef __GNUC__
+        matches += (size_t)__builtin_popcountll(bitmap[w]);
+#else
+        for (uint64_t word = bitmap[w]; word != 0; word &= word - 1) matches++;
+#endif
+    }
+    return matches;
+}
+
+uint64_t *selectStudents(stud_List *list, const StudQuery *query, size_t *matches) 
+{
+    refreshColumns(list);
+
+    const StudColumns *columns = &list->columns;
+    size_t words = (columns->count + 63) / 64;
+    uint64_t *bitmap = malloc((words ? words : 1) * sizeof(*bitmap));
+    if (bitmap == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t found = filterColumns(columns, query, bitmap);
+    if (matches != NULL) *matches = found;
+    return bitmap;
+}
+
+void columnsPrintSelection(const StudColumns *columns, const uint64_t *bitmap, OutBuf *out) 
+{
+    for (size_t r = 0; r < columns->count; r++) 
+    {
+        if (!(bitmap[r / 64] >> (r % 64) & 1)) continue;
+
+        outStudentRow(out, columns->student[r]);
+    }
+}
+
+int requestChangesList(const char *request) 
+{
+    char command[16] = "";
+    sscanf(request, "%15s", command);
+    return strcmp(command, "ADD") == 0 || strcmp(command, "DELETE") == 0;
+}
+
+int executeRequest(stud_List *list, const char *request, OutBuf *out) 
+{
+    char command[16] = "";
+    char first[20] = "", second[20] = "";
+    int fields = sscanf(request, "%15s %19s %19s", command, first, second);
+
+    // Listed students are collected first, the status line goes before them
+    OutBuf rows;
+    outInit(&rows, NULL);
+    size_t count = 0;
+    int changes = 0;
+    const char *error = NULL;
+
+    if (strcmp(command, "PING") == 0) 
+    {
+        // Nothing to do
+    } 
+    
+    else if (strcmp(command, "COUNT") == 0) 
+    {
+        count = list->size;
+    } 
+    
+    else if (strcmp(command, "LIST") == 0) 
+    {
+        for (stud *current = list->head; current != NULL; current = current->next, count++) 
+        {
+            outStudentRow(&rows, current);
+        }
+    } 
+    
+    else if (strcmp(command, "SEARCH") == 0 && fields >= 2) 
+    {
+        count = writeStudentsBySurname(list, first, &rows);
+    } 
+    
+    else if (strcmp(command, "PREFIX") == 0 && fields >= 2) 
+    {
+        count = printStudentsInRange(list, first, first, &rows);
+    } 
+    
+    else if (strcmp(command, "RANGE") == 0 && fields >= 3) 
+    {
+        count = printStudentsInRange(list, first, second, &rows);
+    } 
+    
+    else if (strcmp(command, "SIMILAR") == 0 && fields >= 2) 
+    {
+        int distance = fields >= 3 ? atoi(second) : 2;
+        if (distance < 0 || distance > 3) error = "distance must be between 0 and 3";
+        else count = printStudentsWithSimilarSurname(list, first, distance, &rows);
+    } 
+    
+    else if (strcmp(command, "REPORT") == 0) 
+    {
+        count = list->size;
+        writeStudentsByBands(list, &rows, defaultPerfBands, DEFAULT_PERF_BAND_COUNT);
+    } 
+    
+    else if (strcmp(command, "FILTER") == 0) 
+    {
+        StudQuery query;
+        if (sscanf(request, "%*s %d %d %d %d", &query.minAge, &query.maxAge, &query.minScore, &query.maxScore) != 4) 
+        {
+            error = "usage: FILTER minAge maxAge minGrade maxGrade";
+        } 
+        
+        else 
+        {
+            uint64_t *selection = selectStudents(list, &query, &count);
+            columnsPrintSelection(&list->columns, selection, &rows);
+            free(selection);
+        }
+    } 
+    
+    else if (strcmp(command, "SCORES") == 0) 
+    {
+        int minScore, maxScore;
+        if (sscanf(request, "%*s %d %d", &minScore, &maxScore) != 2) 
+        {
+            error = "usage: SCORES minGrade maxGrade";
+        } 
+        
+        else 
+        {
+            count = printStudentsInScoreRange(list, minScore, maxScore, &rows);
+        }
+    } 
+    
+    else if ((strcmp(command, "TOP") == 0 || strcmp(command, "BOTTOM") == 0 || strcmp(command, "PERCENTILE") == 0) && 
+             fields >= 2) 
+    {
+        StudField field = fields >= 3 && strcmp(second, "age") == 0 ? STUD_FIELD_AGE : STUD_FIELD_SCORE;
+        char *end;
+
+        if (fields >= 3 && strcmp(second, "age") != 0 && strcmp(second, "grade") != 0) 
+        {
+            error = "field must be grade or age";
+        } 
+        
+        else if (command[0] != 'P') 
+        {
+            // strtoull accepts a minus sign and wraps the value around, so it is rejected first
+            errno = 0;
+            unsigned long long wanted = first[0] == '-' ? 0 : strtoull(first, &end, 10);
+
+            if (first[0] == '-') error = "count must not be negative";
+            else if (end == first || *end != '\0') error = "count must be a whole number";
+            else if (errno == ERANGE || wanted > SIZE_MAX) error = "count is too large";
+            else count = printTopStudents(list, field, (size_t)wanted, command[0] == 'T', &rows);
+        } 
+        
+        else 
+        {
+            int value;
+            double percent = strtod(first, &end);
+
+            // NaN fails both comparisons and the infinities the second one
+            if (end == first || *end != '\0' || !(percent >= 0.0 && percent <= 100.0)) 
+            {
+                error = "percentile must be a number between 0 and 100";
+            } 
+            
+            else if (!studentPercentile(list, field, percent, &value)) 
+            {
+                error = "the list is empty";
+            } 
+            
+            else 
+            {
+                count = list->size;
+                outPrintf(&rows, "%d\n", value);
+            }
+        }
+    } 
+    
+    else if (strcmp(command, "GROUP") == 0 && fields >= 2) 
+    {
+        GroupQuery queries[8];
+        size_t queryCount = 0;
+        StudField value = STUD_FIELD_SCORE;
+
+        // Every key word adds a group-by; OF names the summarized field for all of them
+        const char *rest = request;
+        char word[16];
+        int used = 0;
+        sscanf(rest, "%*s%n", &used);
+        rest += used;
+
+        while (error == NULL && sscanf(rest, "%15s%n", word, &used) == 1) 
+        {
+            GroupQuery query = { GROUP_BY_AGE, STUD_FIELD_SCORE, defaultPerfBands, DEFAULT_PERF_BAND_COUNT };
+            rest += used;
+
+            if (strcmp(word, "OF") == 0) 
+            {
+                if (sscanf(rest, "%15s%n", word, &used) == 1 && strcmp(word, "age") == 0) value = STUD_FIELD_AGE;
+                else if (strcmp(word, "grade") != 0) error = "OF must be followed by grade or age";
+                rest += used;
+                continue;
+            }
+
+            if (strcmp(word, "surname") == 0) query.key = GROUP_BY_SURNAME;
+            else if (strcmp(word, "band") == 0) query.key = GROUP_BY_BAND;
+            else if (strcmp(word, "age") != 0) error = "usage: GROUP age|surname|band... [OF grade|age]";
+
+            if (queryCount == sizeof(queries) / sizeof(queries[0])) error = "too many group keys";
+            if (error == NULL) queries[queryCount++] = query;
+        }
+
+        if (error == NULL && queryCount == 0) error = "usage: GROUP age|surname|band... [OF grade|age]";
+
+        if (error == NULL) 
+        {
+            for (size_t q = 0; q < queryCount; q++) queries[q].value = value;
+            count = writeGroups(list, queries, queryCount, &rows);
+        }
+    } 
+    
+    else if (strcmp(command, "ADD") == 0) 
+    {
+        char where[20] = "", after[20] = "";
+        stud data;
+        memset(&data, 0, sizeof(data));
+        changes = 1;
+
+        sscanf(request, "%*s %19s", where);
+        int isAfter = strcmp(where, "AFTER") == 0;
+        int parsed = isAfter 
+            ? sscanf(request, "%*s %*s %19s %19s %9s %19s %d %d", 
+                     after, data.surname, data.name, data.patronymic, &data.age, &data.average_score) - 1
+            : sscanf(request, "%*s %*s %19s %9s %19s %d %d", 
+                     data.surname, data.name, data.patronymic, &data.age, &data.average_score);
+
+        if (parsed != 5 || (!isAfter && strcmp(where, "BEG") != 0 && strcmp(where, "END") != 0)) 
+        {
+            error = "usage: ADD BEG|END|AFTER [surname] surname name patronymic age grade";
+        } 
+        
+        else if (isAfter && findSurnameSlot(list, after) == NULL) 
+        {
+            error = "no student with that surname";
+        } 
+        
+        else 
+        {
+            if (isAfter) 
+            {
+                stud *copy = malloc(sizeof(stud));
+                if (copy == NULL) 
+                {
+                    fprintf(stderr, "Memory allocation failed.\n");
+                    exit(EXIT_FAILURE);
+                }
+                *copy = data;
+                addStudentAfter(list, after, copy);
+                free(copy);
+            } 
+            
+            else if (strcmp(where, "BEG") == 0) 
+            {
+                pushStudBeg(list, &data);
+            } 
+            
+            else 
+            {
+                pushStudEnd(list, &data);
+            }
+
+            // Keep the group sorted, as the menu does after every addition
+            sortStudList(list);
+            count = 1;
+        }
+    } 
+    
+    else if (strcmp(command, "DELETE") == 0 && fields >= 2) 
+    {
+        changes = 1;
+        count = (size_t)deleteStudents(list, first, fields >= 3 ? second : NULL);
+    } 
+    
+    else 
+    {
+        error = "unknown or incomplete request";
+    }
+
+    if (error != NULL) 
+    {
+        outPrintf(out, "ERR %s\n", error);
+    } 
+    
+    else 
+    {
+        outPrintf(out, "OK %zu\n", count);
+        if (rows.length > 0) outWrite(out, rows.data, rows.length);
+    }
+
+    outFree(&rows);
+    return changes;
+}
+
+#ifdef LIST_SERVER
+// Most epoll events handled per wakeup
+#define SERVER_MAX_EVENTS 64
+
+// Client connection of the query server
+typedef struct ServerConn 
+{
+    int fd;
+
+    // Bytes received and not yet taken as a request
+    char *input;
+    size_t inputLength;
+    size_t inputCapacity;
+
+    // Response frame being sent
+    char *output;
+    size_t outputLength;
+    size_t outputSent;
+
+    // A request is with the workers; the connection must live until it is back
+    int busy;
+
+    // The descriptor is registered with epoll; it is taken out while busy
+    int watched;
+
+    // The peer sent everything it will send; answers still go out
+    int peerClosed;
+    int closing;
+
+    struct ServerConn *prev;
+    struct ServerConn *next;
+    
+} ServerConn;
+
+// Request handed to a worker, and its response on the way back
+typedef struct ServerJob 
+{
+    ServerConn *conn;
+    char *request;
+    OutBuf response;
+    struct ServerJob *next;
+    
+} ServerJob;
+
+// State shared by the event loop and the workers
+typedef struct 
+{
+    stud_List *list;
+    pthread_rwlock_t listLock;
+
+    // Pending and finished jobs, guarded by queueLock
+    pthread_mutex_t queueLock;
+    pthread_cond_t queueReady;
+    ServerJob *pendingHead;
+    ServerJob *pendingTail;
+    ServerJob *finished;
+    int stopping;
+
+    // Written by workers to wake the event loop
+    int wakeFd;
+
+    ServerConn *conns;
+
+    // Connections closed while handling the current batch of events,
+    // freed only once no event can refer to them any more
+    ServerConn *closed;
+    
+} Server;
+
+// Set by SIGINT and SIGTERM
+static volatile sig_atomic_t serverStopRequested = 0;
+
+/**
+ * @brief Asks the server loop to stop.
+ * @param signal The signal number.
+ * @return void
+ */
+static void serverStopHandler(int signal) 
+{
+    (void)signal;
+    serverStopRequested = 1;
+}
+
+/**
+ * @brief Runs requests from the job queue until the server stops.
+ * @param arg A pointer to the Server.
+ * @return NULL
+ */
+static void *serverWorker(void *arg) 
+{
+    Server *server = arg;
+
+    for (;;) 
+    {
+        pthread_mutex_lock(&server->queueLock);
+        while (server->pendingHead == NULL && !server->stopping) 
+        {
+            pthread_cond_wait(&server->queueReady, &server->queueLock);
+        }
+        ServerJob *job = server->pendingHead;
+        if (job == NULL) 
+        {
+            pthread_mutex_unlock(&server->queueLock);
+            break;
+        }
+        server->pendingHead = job->next;
+        if (server->pendingHead == NULL) server->pendingTail = NULL;
+        pthread_mutex_unlock(&server->queueLock);
+
+        // Room for the frame length, filled in once the response is complete
+        outInit(&job->response, NULL);
+        outWrite(&job->response, "\0\0\0\0", 4);
+
+        // Reads share the list, changes have it to themselves
+        if (requestChangesList(job->request)) pthread_rwlock_wrlock(&server->listLock);
+        else pthread_rwlock_rdlock(&server->listLock);
+
+        executeRequest(server->list, job->request, &job->response);
+        pthread_rwlock_unlock(&server->listLock);
+
+        uint32_t length = (uint32_t)(job->response.length - 4);
+        unsigned char *header = (unsigned char *)job->response.data;
+        header[0] = (unsigned char)(length >> 24);
+        header[1] = (unsigned char)(length >> 16);
+        header[2] = (unsigned char)(length >> 8);
+        header[3] = (unsigned char)length;
+
+        pthread_mutex_lock(&server->queueLock);
+        job->next = server->finished;
+        server->finished = job;
+        pthread_mutex_unlock(&server->queueLock);
+
+        uint64_t one = 1;
+        if (write(server->wakeFd, &one, sizeof(one)) < 0) 
+        {
+            // The counter is already non-zero, the loop will wake up anyway
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Closes a connection; its memory is kept until serverFreeClosed.
+ * @param server A pointer to the server.
+ * @param conn The connection.
+ * @return void
+ */
+static void serverCloseConn(Server *server, ServerConn *conn) 
+{
+    if (conn->prev) conn->prev->next = conn->next;
+    else server->conns = conn->next;
+    if (conn->next) conn->next->prev = conn->prev;
 
-                saveListToFile(list, "students.txt");
-                break;
-            case 8:
-                printf("Exiting...\n");
-                freeList(list);
-                break;
-            default:
-                printf("Invalid choice, please try again.\n");
+    close(conn->fd);
+    conn->fd = -1;
+    conn->next = server->closed;
+    server->closed = conn;
+}
+
+/**
+ * @brief Frees the connections closed since the last call.
+ * @param server A pointer to the server.
+ * @return void
+ */
+static void serverFreeClosed(Server *server) 
+{
+    while (server->closed != NULL) 
+    {
+        ServerConn *next = server->closed->next;
+        free(server->closed->input);
+        free(server->closed->output);
+        free(server->closed);
+        server->closed = next;
+    }
+}
+
+/**
+ * @brief Sends as much of the pending response as the socket takes.
+ * @param conn The connection.
+ * @return void
+ */
+static void serverSend(ServerConn *conn) 
+{
+    while (conn->output != NULL && conn->outputSent < conn->outputLength) 
+    {
+        ssize_t sent = send(conn->fd, conn->output + conn->outputSent, conn->outputLength - conn->outputSent, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (sent <= 0) 
+        {
+            conn->closing = 1;
+            return;
         }
-    } while (choice != 8);
+        conn->outputSent += (size_t)sent;
+    }
 
-    return 0;
+    if (conn->output != NULL) 
+    {
+        free(conn->output);
+        conn->output = NULL;
+        conn->outputLength = conn->outputSent = 0;
+    }
 }
 
-void printstud_List(stud_List *list) 
+/**
+ * @brief Hands the next complete request of a connection to the workers.
+ * A connection has at most one request in flight, so responses keep the request order.
+ * @param server A pointer to the server.
+ * @param conn The connection.
+ * @return void
+ */
+static void serverDispatch(Server *server, ServerConn *conn) 
 {
-    // Check if the list is empty
-    if (list == NULL || list->head == NULL) 
-	{
-        printf("The list is empty.\n");
+    if (conn->busy || conn->closing || conn->output != NULL || conn->inputLength < 4) return;
+
+    const unsigned char *header = (const unsigned char *)conn->input;
+    size_t length = (size_t)header[0] << 24 | (size_t)header[1] << 16 | (size_t)header[2] << 8 | header[3];
+
+    if (length > SERVER_MAX_REQUEST) 
+    {
+        conn->closing = 1;
         return;
     }
+    if (conn->inputLength < 4 + length) return;
 
-    stud *current = list->head;
-    
-    // Print table header
-    printf("\n%-20s %-10s %-20s %-10s %-10s\n", "Surname", "Name", "Patronymic", "Age", "Grade");
-    printf("-------------------------------------------------------------------------------\n");
-    
-    // Go through and print all elements of the list
-    while (current != NULL) 
-	{
-        printf("%-20s %-10s %-20s %-10d %-10d\n", 
-               current->surname, 
-               current->name, 
-               current->patronymic, 
-               current->age, 
-               current->average_score);
-        current = current->next;
+    ServerJob *job = malloc(sizeof(ServerJob));
+    char *request = malloc(length + 1);
+    if (job == NULL || request == NULL) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        exit(EXIT_FAILURE);
     }
-    printf("\n");
+
+    memcpy(request, conn->input + 4, length);
+    request[length] = '\0';
+    conn->inputLength -= 4 + length;
+    memmove(conn->input, conn->input + 4 + length, conn->inputLength);
+
+    job->conn = conn;
+    job->request = request;
+    job->next = NULL;
+    conn->busy = 1;
+
+    pthread_mutex_lock(&server->queueLock);
+    if (server->pendingTail) server->pendingTail->next = job;
+    else server->pendingHead = job;
+    server->pendingTail = job;
+    pthread_cond_signal(&server->queueReady);
+    pthread_mutex_unlock(&server->queueLock);
 }
 
-stud_List* createList() 
+/**
+ * @brief Reads everything available on a connection.
+ * @param conn The connection.
+ * @return void
+ */
+static void serverReceive(ServerConn *conn) 
 {
-    // Allocate memory for the new list structure
-	stud_List *tmp = (stud_List*) malloc(sizeof(stud_List));
-    
-    if (tmp == NULL) 
-	{
-        // If memory is not allocated, print an error message
-        printf("Error allocating memory\n");
-        return NULL;
+    for (;;) 
+    {
+        if (conn->inputCapacity - conn->inputLength < 4096) 
+        {
+            size_t capacity = conn->inputCapacity ? conn->inputCapacity * 2 : 8192;
+            char *input = realloc(conn->input, capacity);
+            if (input == NULL) 
+            {
+                conn->closing = 1;
+                return;
+            }
+            conn->input = input;
+            conn->inputCapacity = capacity;
+        }
+
+        ssize_t got = recv(conn->fd, conn->input + conn->inputLength, conn->inputCapacity - conn->inputLength, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (got < 0) 
+        {
+            conn->closing = 1;
+            return;
+        }
+        if (got == 0) 
+        {
+            conn->peerClosed = 1;
+            return;
+        }
+        conn->inputLength += (size_t)got;
+
+        // Do not buffer more than one oversized request
+        if (conn->inputLength > SERVER_MAX_REQUEST + 4 + 4096) return;
     }
-    
-    // Initialize pointers and list size
-    tmp->head = tmp->tail = NULL;
-    tmp->size = 0;
-    
-    return tmp;
 }
 
-void addStudBeg(stud_List *list) 
+/**
+ * @brief Moves a connection on after it was read from, written to or answered.
+ * The next request is dispatched, and the connection is closed once it failed,
+ * or once its peer stopped sending and every answer is out; otherwise the
+ * events it waits for are updated.
+ * @param server A pointer to the server.
+ * @param epoll The epoll descriptor.
+ * @param conn The connection.
+ * @return void
+ */
+static void serverSettle(Server *server, int epoll, ServerConn *conn) 
 {
-    // Allocate memory for the new node
-    stud* new_node = malloc(sizeof(stud));
-    
-    if (new_node == NULL) 
-	{
-        // If memory is not allocated, display an error message
-    	printf("Error allocating memory\n");
+    serverDispatch(server, conn);
+
+    if (conn->busy) 
+    {
+        // Nothing to read or write until the worker is done. A hangup is
+        // reported even with no events asked for, and level-triggered it would
+        // wake the loop over and over, so the descriptor leaves epoll instead
+        if (conn->watched) 
+        {
+            epoll_ctl(epoll, EPOLL_CTL_DEL, conn->fd, NULL);
+            conn->watched = 0;
+        }
         return;
-	}
-	
-    // Read student data from the keyboard
-	printf("\nEnter surname: ");
-    scanf("%19s", new_node->surname);
-    printf("Enter name: ");
-    scanf("%9s", new_node->name);
-    printf("Enter patronymic: ");
-    scanf("%19s", new_node->patronymic);
-    
-    printf("Enter age: ");
-    scanf("%d", &new_node->age);
-    
-    printf("Enter average Grade: ");
-    scanf("%d", &new_node->average_score);
+    }
 
-    // Add the node to the beginning of the list
-    new_node->next = list->head;
-    new_node->prev = NULL;
-    
-    if (list->head != NULL) 
-	{ 
-        // If the list is not empty, update the pointer to the previous element of the old head
-        list->head->prev = new_node; 
-    } 
-    
-    else
+    if (conn->closing || (conn->peerClosed && conn->output == NULL)) 
     {
-        // If the list was empty, set the new node as the tail
-    	list->tail = new_node;
-	}
-    
-    list->head = new_node;
+        serverCloseConn(server, conn);
+        return;
+    }
 
-    // Increase the size of the list
-    list->size++;
+    struct epoll_event event = { 0, { .ptr = conn } };
+    if (!conn->peerClosed) event.events |= EPOLLIN | EPOLLRDHUP;
+    if (conn->output != NULL) event.events |= EPOLLOUT;
+    epoll_ctl(epoll, conn->watched ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, conn->fd, &event);
+    conn->watched = 1;
 }
 
-void addStudEnd(stud_List *list) 
+int runServer(stud_List *list, const char *socketPath, int workers) 
 {
-    // Allocate memory for the new node
-    stud *new_node = malloc(sizeof(stud));
-    if (new_node == NULL) 
-	{
-        printf("Error allocating memory\n");
-        return;
+    struct sockaddr_un address;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) 
+    {
+        fprintf(stderr, "Socket path too long: %s\n", socketPath);
+        return 0;
     }
+    if (workers < 1) workers = 1;
+    if (workers > 64) workers = 64;
 
-    // Read student data from the keyboard
-    printf("\nEnter surname: ");
-    scanf("%19s", new_node->surname);
-    printf("Enter name: ");
-    scanf("%9s", new_node->name);
-    printf("Enter patronymic: ");
-    scanf("%19s", new_node->patronymic);
-    printf("Enter age: ");
-    scanf("%d", &new_node->age);
-    printf("Enter average Grade: ");
-    scanf("%d", &new_node->average_score);
-    
-    // Set next for the new node as NULL, since it will be the last one
-    new_node->next = NULL;  
-    
-    if (list->head == NULL) 
-	{
-        // If the list is empty, set the new node as the head and tail of the list
-        list->head = new_node; 
-        list->tail = new_node;
-        new_node->prev = NULL;  
-    } 
-    
-    else 
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listener < 0) 
     {
-        // Otherwise, add a new node to the end of the list
-        list->tail->next = new_node; 
-        new_node->prev = list->tail; 
-        list->tail = new_node;       
+        perror("Error creating socket");
+        return 0;
     }
 
-    // Increase the size of the list
-    list->size++;  
-}
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath);
+    unlink(socketPath);
 
-void sortStudList(stud_List *list) 
-{
-    // Check if there are items to be sorted
-    if (!list->head || !list->head->next) return;
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 128) != 0) 
+    {
+        perror("Error binding socket");
+        close(listener);
+        return 0;
+    }
 
-    int swapped;
-    do 
+    Server server;
+    memset(&server, 0, sizeof(server));
+    server.list = list;
+    pthread_rwlock_init(&server.listLock, NULL);
+    pthread_mutex_init(&server.queueLock, NULL);
+    pthread_cond_init(&server.queueReady, NULL);
+    server.wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    int epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll < 0 || server.wakeFd < 0) 
     {
-        swapped = 0;
-        stud *current = list->head;
-        
-        while (current->next) 
+        perror("Error creating event loop");
+        if (epoll >= 0) close(epoll);
+        if (server.wakeFd >= 0) close(server.wakeFd);
+        close(listener);
+        unlink(socketPath);
+        return 0;
+    }
+
+    // The listener and the wakeup counter are told apart from connections by their pointers
+    struct epoll_event event = { EPOLLIN, { .ptr = &listener } };
+    epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event);
+    event.data.ptr = &server;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, server.wakeFd, &event);
+
+    pthread_t threads[64];
+    int started = 0;
+    while (started < workers && pthread_create(&threads[started], NULL, serverWorker, &server) == 0) 
+    {
+        started++;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = serverStopHandler;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    serverStopRequested = 0;
+
+    printf("Serving %zu students on %s with %d workers\n", list->size, socketPath, started);
+    fflush(stdout);
+
+    // With metrics on, the loop wakes up every second to keep the file current
+#ifdef LIST_METRICS
+    int timeout = 1000;
+#else
+    int timeout = -1;
+#endif
+
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    while (!serverStopRequested && started > 0) 
+    {
+#ifdef LIST_METRICS
+        pthread_rwlock_rdlock(&server.listLock);
+        metricsTick(list);
+        pthread_rwlock_unlock(&server.listLock);
+#endif
+
+        int ready = epoll_wait(epoll, events, SERVER_MAX_EVENTS, timeout);
+        if (ready < 0) 
         {
-            if (strcmp(current->surname, current->next->surname) > 0 || 
-               (strcmp(current->surname, current->next->surname) == 0 && strcmp(current->name, current->next->name) > 0)) {
-                
-                // Exchange nodes if the current node is larger than the next node
-                stud *next = current->next;
-                stud *prev = current->prev;
+            if (errno == EINTR) continue;
+            perror("Error waiting for events");
+            break;
+        }
 
-                if (prev) 
-                {
-                    prev->next = next;
-                } 
-                
-                else 
+        for (int i = 0; i < ready; i++) 
+        {
+            if (events[i].data.ptr == &listener) 
+            {
+                int fd;
+                while ((fd = accept(listener, NULL, NULL)) >= 0) 
                 {
-                    list->head = next;
+                    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+                    ServerConn *conn = calloc(1, sizeof(ServerConn));
+                    if (conn == NULL) 
+                    {
+                        close(fd);
+                        continue;
+                    }
+                    conn->fd = fd;
+                    conn->next = server.conns;
+                    if (server.conns) server.conns->prev = conn;
+                    server.conns = conn;
+
+                    struct epoll_event added = { EPOLLIN | EPOLLRDHUP, { .ptr = conn } };
+                    epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &added);
+                    conn->watched = 1;
                 }
-                
-                current->next = next->next;
-                current->prev = next;
-                next->next = current;
-                next->prev = prev;
+                continue;
+            }
 
-                if (current->next) 
+            if (events[i].data.ptr == &server) 
+            {
+                uint64_t counter;
+                if (read(server.wakeFd, &counter, sizeof(counter)) < 0) 
                 {
-                    current->next->prev = current;
-                } 
+                    // Nothing to read: another wakeup already drained it
+                }
 
-                else 
+                pthread_mutex_lock(&server.queueLock);
+                ServerJob *job = server.finished;
+                server.finished = NULL;
+                pthread_mutex_unlock(&server.queueLock);
+
+                while (job != NULL) 
                 {
-                    list->tail = current;
-                }
+                    ServerJob *next = job->next;
+                    ServerConn *conn = job->conn;
+                    conn->busy = 0;
 
-                swapped = 1;
-            } 
-            
-            else 
-            {
-                current = current->next;
+                    if (conn->closing) 
+                    {
+                        outFree(&job->response);
+                    } 
+                    
+                    else 
+                    {
+                        // The connection takes over the response buffer
+                        conn->output = job->response.data;
+                        conn->outputLength = job->response.length;
+                        conn->outputSent = 0;
+                        serverSend(conn);
+                    }
+                    serverSettle(&server, epoll, conn);
+
+                    free(job->request);
+                    free(job);
+                    job = next;
+                }
+                continue;
             }
-        }
-    } while (swapped);
-}
 
+            ServerConn *conn = events[i].data.ptr;
+            if (conn->fd < 0) continue;
 
-void searchAndPrintBySurname(stud_List *list, const char *surname) 
-{
-    // Check if the list is empty
-    if (list == NULL || list->head == NULL) 
-	{
-        printf("The list is empty.\n");
-        return;
-    }
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP)) serverReceive(conn);
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) conn->closing = 1;
+            if ((events[i].events & EPOLLOUT) && !conn->closing) serverSend(conn);
 
-    stud *current = list->head;
-    int found = 0;
+            serverSettle(&server, epoll, conn);
+        }
+        serverFreeClosed(&server);
+    }
 
-    // Print table header
-    printf("\n%-20s %-10s %-20s %-10s %-10s\n", "Surname", "Name", "Patronymic", "Age", "Grade");
-    printf("-------------------------------------------------------------------------------\n");
+    // Let the workers finish what they have and stop
+    pthread_mutex_lock(&server.queueLock);
+    server.stopping = 1;
+    pthread_cond_broadcast(&server.queueReady);
+    pthread_mutex_unlock(&server.queueLock);
 
-    // Search for students with the specified last name
-    while (current != NULL)
-	{
-        if (strcmp(current->surname, surname) == 0) 
-		{
-            printf("%-20s %-10s %-20s %-10d %-10d\n",
-                   current->surname, 
-                   current->name, 
-                   current->patronymic, 
-                   current->age, 
-                   current->average_score);
-            found = 1;
-        }
-        current = current->next;
+    for (int i = 0; i < started; i++) 
+    {
+        pthread_join(threads[i], NULL);
     }
 
-    if (!found) 
-	{
-        printf("No student found with the surname '%s'.\n", surname);
+    while (server.finished != NULL) 
+    {
+        ServerJob *next = server.finished->next;
+        outFree(&server.finished->response);
+        free(server.finished->request);
+        free(server.finished);
+        server.finished = next;
     }
+    while (server.conns != NULL) 
+    {
+        serverCloseConn(&server, server.conns);
+    }
+    serverFreeClosed(&server);
+
+#ifdef LIST_METRICS
+    metricsWrite(list, LIST_METRICS_FILE);
+#endif
+
+    close(epoll);
+    close(server.wakeFd);
+    close(listener);
+    unlink(socketPath);
+
+    pthread_cond_destroy(&server.queueReady);
+    pthread_mutex_destroy(&server.queueLock);
+    pthread_rwlock_destroy(&server.listLock);
+
+    printf("Server stopped\n");
+    return 1;
 }
 
-int del_Nth(stud_List * list, char *surname) 
+int queryServer(const char *socketPath, const char *request, FILE *output) 
 {
-    // Check if the list is empty and if the input data is correct
-    if (list == NULL || list->head == NULL || surname == NULL) 
+    struct sockaddr_un address;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) 
+    {
+        fprintf(stderr, "Socket path too long: %s\n", socketPath);
+        return 0;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) 
     {
+        perror("Error creating socket");
         return 0;
     }
-    
-    stud *current = list->head;
-    int count = 0;
-    int surnameCount = 0;
 
-    // First, count the number of students with the same surname
-    while (current != NULL) 
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath);
+
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) 
     {
-        if (strcmp(current->surname, surname) == 0) 
-        {
-            surnameCount++;
-        }
-        current = current->next;
+        perror("Error connecting to server");
+        close(fd);
+        return 0;
     }
 
-    // If multiple students with the same surname are found, ask for the name
-    char name[20] = "";
-    if (surnameCount > 1) 
+    size_t length = strlen(request);
+    unsigned char header[4] = 
     {
-        printf("There are %d students with the surname %s. Please enter the name: ", surnameCount, surname);
-        scanf("%19s", name);
+        (unsigned char)(length >> 24), (unsigned char)(length >> 16), (unsigned char)(length >> 8), (unsigned char)length
+    };
+
+    int ok = send(fd, header, 4, MSG_NOSIGNAL) == 4 && send(fd, request, length, MSG_NOSIGNAL) == (ssize_t)length;
+
+    // Read the response frame: its length first, then the text
+    size_t got = 0;
+    while (ok && got < 4) 
+    {
+        ssize_t n = recv(fd, header + got, 4 - got, 0);
+        if (n <= 0) ok = 0;
+        else got += (size_t)n;
     }
 
-    current = list->head;
-    while (current != NULL) 
+    size_t responseLength = ok ? (size_t)header[0] << 24 | (size_t)header[1] << 16 | (size_t)header[2] << 8 | header[3] : 0;
+    char *response = ok ? malloc(responseLength + 1) : NULL;
+    if (ok && response == NULL) ok = 0;
+
+    got = 0;
+    while (ok && got < responseLength) 
     {
-        stud *next = current->next;
-        if (strcmp(current->surname, surname) == 0 && (surnameCount == 1 || strcmp(current->name, name) == 0)) 
-        {
-            // Delete the node
-            if (current->prev) 
-            {
-                current->prev->next = current->next;
-            } else {
-                list->head = current->next;
-            }
-            
-            if (current->next) 
-            {
-                current->next->prev = current->prev;
-            } else {
-                list->tail = current->prev;
-            }
+        ssize_t n = recv(fd, response + got, responseLength - got, 0);
+        if (n <= 0) ok = 0;
+        else got += (size_t)n;
+    }
+    close(fd);
 
-            free(current);
-            list->size--; 
-            count++;
-        }
-        current = next;
+    if (!ok) 
+    {
+        fprintf(stderr, "No response from server\n");
+        free(response);
+        return 0;
     }
 
-    return count;
+    fwrite(response, 1, responseLength, output);
+    ok = responseLength >= 2 && memcmp(response, "OK", 2) == 0;
+    free(response);
+    return ok;
 }
+#endif
 
-stud *findStudentBySurname(stud_List *list, const char *surname) 
-{
-	// Check if the list is empty
-    if (list == NULL || list->head == NULL) 
-	{
-        printf("The list is empty or NULL.\n");
-        return NULL;  
-    }
+// Largest surname vocabulary of generated rosters
+#define ROSTER_MAX_SURNAMES (1u << 20)
 
-    stud *current = list->head;
+// Draws surnames of a generated roster: rank r is drawn with a probability
+// proportional to 1 / (r + 1)
+typedef struct 
+{
+    uint64_t state;
+    double *cdf;
+    uint32_t count;
+    uint32_t mask;
     
-    // Search for a student with the specified last name
-    while (current != NULL) 
-	{
-        if (strcmp(current->surname, surname) == 0)
-		{
-            return current;
-        }
-        current = current->next;
-    }
-    return NULL;
+} SurnameSampler;
+
+static const char *const rosterRoots[32] = 
+{
+    "Ab", "Bar", "Cal", "Dun", "El", "Far", "Gar", "Hal", "Ir", "Jen", "Kel", "Lor", "Mar", "Nor", "Ol", "Pem",
+    "Quin", "Ros", "Sal", "Tor", "Ul", "Var", "Wel", "Yor", "Zan", "Bren", "Cor", "Dal", "Fen", "Har", "Lin", "Mor"
+};
+
+static const char *const rosterSyllables[16] = 
+{
+    "a", "e", "i", "o", "an", "en", "er", "in", "on", "ar", "el", "il", "ow", "ry", "ad", "ol"
+};
+
+static const char *const rosterEndings[8] = 
+{
+    "son", "ton", "ley", "man", "ford", "well", "er", "s"
+};
+
+static const char *const rosterNames[32] = 
+{
+    "Henry", "Simon", "Emily", "Michael", "Olivia", "James", "Sophia", "Daniel",
+    "Samantha", "William", "Emma", "Jack", "Grace", "Thomas", "Lucy", "Oliver",
+    "Chloe", "Harry", "Ella", "George", "Amelia", "Noah", "Mia", "Leo",
+    "Ava", "Oscar", "Isla", "Arthur", "Ruby", "Charlie", "Alice", "Jacob"
+};
+
+/**
+ * @brief Returns the next number of a splitmix64 generator.
+ * @param state The state of the generator.
+ * @return A uniformly distributed 64-bit number.
+ */
+static uint64_t nextRandom(uint64_t *state) 
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
 }
 
-void addStudentAfter(stud_List *list, const char *surname, stud *newStudentData) 
+/**
+ * @brief Prepares the surname distribution of a roster.
+ * @param sampler The sampler to set up.
+ * @param rows The number of students in the roster.
+ * @param seed The seed of the random generator.
+ * @return 1 on success, 0 if memory ran out.
+ */
+static int surnameSamplerInit(SurnameSampler *sampler, uint64_t rows, uint64_t seed) 
 {
-    // Search for a student with the specified last name
-    stud *foundStud = findStudentBySurname(list, surname);
-    if (foundStud == NULL) 
+    // About twenty students per surname, within sensible bounds
+    uint64_t count = rows / 20;
+    if (count < 64) count = 64;
+    if (count > ROSTER_MAX_SURNAMES) count = ROSTER_MAX_SURNAMES;
+
+    sampler->state = seed;
+    sampler->count = (uint32_t)count;
+    sampler->mask = 1;
+    while (sampler->mask < sampler->count) sampler->mask <<= 1;
+    sampler->mask--;
+
+    sampler->cdf = malloc(count * sizeof(double));
+    if (sampler->cdf == NULL) return 0;
+
+    double total = 0;
+    for (uint32_t r = 0; r < sampler->count; r++) 
     {
-        printf("No student found with the surname: %s\n", surname);
-        free(newStudentData);
-        return;
+        total += 1.0 / (r + 1);
+        sampler->cdf[r] = total;
     }
-
-    // Allocate memory for the new student
-    stud *newStud = (stud *)malloc(sizeof(stud));
-    if (newStud == NULL) 
+    for (uint32_t r = 0; r < sampler->count; r++) 
     {
-        fprintf(stderr, "Memory allocation failed.\n");
-        exit(EXIT_FAILURE);
+        sampler->cdf[r] /= total;
     }
-    // Copy the data
-    *newStud = *newStudentData;  
+    return 1;
+}
 
-    // Insert a new student after the found one
-    newStud->next = foundStud->next;  
-    newStud->prev = foundStud;        
+/**
+ * @brief Writes the surname of a rank.
+ * Ranks are scattered over the vocabulary, so common surnames are spread
+ * over the alphabet instead of sharing a prefix.
+ * @param sampler The sampler.
+ * @param rank The rank, 0 being the most common surname.
+ * @param surname The buffer receiving the surname, at least 20 bytes.
+ * @return void
+ */
+static void rosterSurname(const SurnameSampler *sampler, uint32_t rank, char *surname) 
+{
+    uint32_t code = (rank * 0x9E3779B1u) & sampler->mask;
 
-    if (foundStud->next != NULL)      
+    // Root, ending and up to three syllables in between, at most 18 letters
+    strcpy(surname, rosterRoots[code & 31]);
+    const char *ending = rosterEndings[(code >> 5) & 7];
+    for (code >>= 8; code != 0; code >>= 4) 
     {
-        foundStud->next->prev = newStud;  
+        strcat(surname, rosterSyllables[code & 15]);
     }
-    foundStud->next = newStud;  
+    strcat(surname, ending);
+}
 
-    if (newStud->next == NULL)  
+/**
+ * @brief Draws the rank of a surname.
+ * @param sampler The sampler.
+ * @return The rank, 0 being the most common surname.
+ */
+static uint32_t drawSurnameRank(SurnameSampler *sampler) 
+{
+    double u = (double)(nextRandom(&sampler->state) >> 11) * (1.0 / 9007199254740992.0);
+
+    // First rank whose cumulative probability exceeds u
+    uint32_t low = 0, high = sampler->count - 1;
+    while (low < high) 
     {
-        list->tail = newStud;   
+        uint32_t middle = low + (high - low) / 2;
+        if (sampler->cdf[middle] > u) high = middle;
+        else low = middle + 1;
     }
+    return low;
 }
 
-void printStudentsByPerformanceHelper(stud_List *list, FILE *output) 
+int generateRoster(const char *filename, uint64_t rows, uint64_t seed) 
 {
-    // Check if the list is empty
-    if (list == NULL || list->head == NULL) 
+    SurnameSampler sampler;
+    if (!surnameSamplerInit(&sampler, rows, seed)) 
     {
-        fprintf(output, "The list is empty.\n");
-        return;
+        fprintf(stderr, "Memory allocation failed.\n");
+        return 0;
     }
 
-    // Print students by grade category
-    fprintf(output, "\nExcellent (90-100):\n");
-    int found = 0;
-    stud *current = list->head;
-    while (current != NULL) 
+    FILE *file = fopen(filename, "w");
+    if (!file) 
     {
-        if (current->average_score >= 90 && current->average_score <= 100) 
-        {
-            fprintf(output, "%-20s %-10s %-20s %-10d %-10d\n", current->surname, current->name, current->patronymic, current->age, current->average_score);
-            found = 1;
-        }
-        current = current->next;
+        perror("Error opening file for writing");
+        free(sampler.cdf);
+        return 0;
     }
-    if (!found) fprintf(output, "No students found\n");
 
-    fprintf(output, "\nGood (70-89):\n");
-    found = 0;
-    current = list->head;
-    while (current != NULL) 
+    OutBuf out;
+    outInit(&out, file);
+    char surname[20];
+
+    for (uint64_t i = 0; i < rows; i++) 
     {
-        if (current->average_score >= 70 && current->average_score <= 89) 
-        {
-            fprintf(output, "%-20s %-10s %-20s %-10d %-10d\n", current->surname, current->name, current->patronymic, current->age, current->average_score);
-            found = 1;
-        }
-        current = current->next;
+        rosterSurname(&sampler, drawSurnameRank(&sampler), surname);
+        uint64_t bits = nextRandom(&sampler.state);
+
+        // Ages 17 to 25; grades 40 to 100, most of them around 70
+        int age = 17 + (int)(bits % 9);
+        int grade = 40 + (int)((bits >> 8) % 21) + (int)((bits >> 16) % 21) + (int)((bits >> 24) % 21);
+
+        outPrintf(&out, "%s %s - %d %d\n", surname, rosterNames[(bits >> 32) & 31], age, grade);
     }
-    if (!found) fprintf(output, "No students found\n");
 
-    fprintf(output, "\nSatisfactory (50-69):\n");
-    found = 0;
-    current = list->head;
-    while (current != NULL) 
+    outFree(&out);
+    free(sampler.cdf);
+
+    if (ferror(file) | fclose(file)) 
     {
-        if (current->average_score >= 50 && current->average_score <= 69) 
-        {
-            fprintf(output, "%-20s %-10s %-20s %-10d %-10d\n", current->surname, current->name, current->patronymic, current->age, current->average_score);
-            found = 1;
-        }
-        current = current->next;
+        perror("Error writing file");
+        return 0;
     }
-    if (!found) fprintf(output, "No students found\n");
+    return 1;
+}
 
-    fprintf(output, "\nUnsatisfactory (0-49):\n");
-    found = 0;
-    current = list->head;
-    while (current != NULL) 
+// Timings of one benchmarked operation
+typedef struct 
+{
+    const char *name;
+    const char *unit;
+    uint64_t items;
+    double *seconds;
+    size_t count;
+    size_t capacity;
+    
+} BenchSeries;
+
+/**
+ * @brief Reads a monotonic clock.
+ * @return The time in seconds.
+ */
+static double benchNow(void) 
+{
+#if defined(LIST_POSIX) && defined(CLOCK_MONOTONIC)
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/**
+ * @brief Records the duration of one run of an operation.
+ * @param series The timings of the operation.
+ * @param seconds The duration.
+ * @return void
+ */
+static void benchRecord(BenchSeries *series, double seconds) 
+{
+    if (series->count == series->capacity) 
     {
-        if (current->average_score >= 0 && current->average_score <= 49) 
+        size_t capacity = series->capacity ? series->capacity * 2 : 16;
+        double *grown = realloc(series->seconds, capacity * sizeof(double));
+        if (grown == NULL) 
         {
-            fprintf(output, "%-20s %-10s %-20s %-10d %-10d\n", current->surname, current->name, current->patronymic, current->age, current->average_score);
-            found = 1;
+            fprintf(stderr, "Memory allocation failed.\n");
+            exit(EXIT_FAILURE);
         }
-        current = current->next;
+        series->seconds = grown;
+        series->capacity = capacity;
     }
-    if (!found) fprintf(output, "No students found\n");
+    series->seconds[series->count++] = seconds;
 }
 
-void printStudByPerf(stud_List *list) 
+/**
+ * @brief Compares two durations for qsort.
+ * @param a The first duration.
+ * @param b The second duration.
+ * @return A negative value, zero or a positive value.
+ */
+static int compareSeconds(const void *a, const void *b) 
 {
-    printStudentsByPerformanceHelper(list, stdout);
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
 }
 
-void freeList(stud_List *list) 
+/**
+ * @brief Writes the JSON object of an operation: throughput and latency percentiles.
+ * @param output The file to write to.
+ * @param series The timings of the operation; they are sorted in place.
+ * @param last Non-zero for the last object of the array.
+ * @return void
+ */
+static void benchWriteSeries(FILE *output, BenchSeries *series, int last) 
 {
-    stud *current = list->head;
-    while (current != NULL) 
+    double total = 0;
+    for (size_t i = 0; i < series->count; i++) total += series->seconds[i];
+    qsort(series->seconds, series->count, sizeof(double), compareSeconds);
+
+    // Nearest-rank percentiles
+    double percentiles[4] = { 0.50, 0.90, 0.99, 1.0 };
+    double values[4] = { 0, 0, 0, 0 };
+    for (int p = 0; p < 4 && series->count > 0; p++) 
     {
-        stud *next = current->next;
-        free(current);
-        current = next;
+        size_t rank = (size_t)(percentiles[p] * series->count + 0.999999);
+        if (rank < 1) rank = 1;
+        values[p] = series->seconds[rank - 1] * 1e6;
     }
 
-    free(list);
+    double mean = series->count ? total / series->count : 0;
+    fprintf(output, "    {\"name\": \"%s\", \"samples\": %zu, \"items_per_sample\": %llu, ", 
+            series->name, series->count, (unsigned long long)series->items);
+    fprintf(output, "\"throughput\": %.1f, \"unit\": \"%s\", ", mean > 0 ? series->items / mean : 0.0, series->unit);
+    fprintf(output, "\"latency_us\": {\"mean\": %.2f, \"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, \"max\": %.2f}}%s\n",
+            mean * 1e6, values[0], values[1], values[2], values[3], last ? "" : ",");
 }
 
-void loadListFromFile(stud_List *list, const char *filename) 
+int runBenchmark(uint64_t rows, int rounds, uint64_t seed, FILE *output) 
 {
-    FILE *file = fopen(filename, "r");
+    const char *rosterPath = "bench_students.txt";
+    const char *savedPath = "bench_saved.txt";
+    if (rounds < 1) rounds = 1;
 
-    if (!file) 
+    BenchSeries series[] = 
     {
-        perror("Error opening file for reading");
-        return;
+        { "generate", "rows/s", rows, NULL, 0, 0 },
+        { "loadListFromFile", "rows/s", rows, NULL, 0, 0 },
+        { "sortStudList", "rows/s", rows, NULL, 0, 0 },
+        { "performanceReport", "rows/s", rows, NULL, 0, 0 },
+        { "saveListToFile", "rows/s", rows, NULL, 0, 0 },
+        { "searchBySurname", "queries/s", 1, NULL, 0, 0 },
+        { "deleteBySurnameAndName", "deletions/s", 1, NULL, 0, 0 }
+    };
+    enum { GENERATE, LOAD, SORT, REPORT, SAVE, SEARCH, DELETE, SERIES_COUNT };
+
+    fprintf(stderr, "Generating %llu students\n", (unsigned long long)rows);
+    double start = benchNow();
+    if (!generateRoster(rosterPath, rows, seed)) return 0;
+    benchRecord(&series[GENERATE], benchNow() - start);
+
+    // Queries draw from the same surnames as the roster, with their own seed
+    SurnameSampler queries;
+    if (!surnameSamplerInit(&queries, rows, seed ^ 0x5DEECE66DULL)) 
+    {
+        fprintf(stderr, "Memory allocation failed.\n");
+        remove(rosterPath);
+        return 0;
     }
 
-    stud buffer;
-    while (fscanf(file, "%19s %9s %19s %d %d",
-                  buffer.surname,
-                  buffer.name,
-                  buffer.patronymic,
-                  &buffer.age,
-                  &buffer.average_score) == 5) {
+    // Rows are formatted into memory and dropped, so only the list is measured
+    OutBuf sink;
+    outInit(&sink, NULL);
+    char surname[20];
 
-        stud *newStudent = malloc(sizeof(stud));
+    for (int round = 0; round < rounds; round++) 
+    {
+        fprintf(stderr, "Round %d of %d\n", round + 1, rounds);
+        stud_List *list = createList();
 
-        if (!newStudent) 
-        {
-            perror("Memory allocation failed");
-            fclose(file);
-            return;
-        }
-        *newStudent = buffer;
-        newStudent->next = NULL;
-        newStudent->prev = NULL;
+        start = benchNow();
+        loadListFromFile(list, rosterPath);
+        benchRecord(&series[LOAD], benchNow() - start);
 
-        if (list->head == NULL) 
-        {
-            list->head = list->tail = newStudent;
-        } 
+        start = benchNow();
+        sortStudList(list);
+        benchRecord(&series[SORT], benchNow() - start);
 
-        else 
+        start = benchNow();
+        writeStudentsByBands(list, &sink, defaultPerfBands, DEFAULT_PERF_BAND_COUNT);
+        benchRecord(&series[REPORT], benchNow() - start);
+        sink.length = 0;
+
+        start = benchNow();
+        saveListToFile(list, savedPath);
+        benchRecord(&series[SAVE], benchNow() - start);
+
+        if (round == rounds - 1) 
         {
-            list->tail->next = newStudent;
-            newStudent->prev = list->tail;
-            list->tail = newStudent;
+            uint64_t operations = rows < 10000 ? rows : 10000;
+
+            for (uint64_t i = 0; i < operations; i++) 
+            {
+                rosterSurname(&queries, drawSurnameRank(&queries), surname);
+                start = benchNow();
+                writeStudentsBySurname(list, surname, &sink);
+                benchRecord(&series[SEARCH], benchNow() - start);
+                sink.length = 0;
+            }
+
+            for (uint64_t i = 0; i < operations; i++) 
+            {
+                rosterSurname(&queries, drawSurnameRank(&queries), surname);
+                const char *name = rosterNames[nextRandom(&queries.state) & 31];
+                start = benchNow();
+                deleteStudents(list, surname, name);
+                benchRecord(&series[DELETE], benchNow() - start);
+            }
         }
-        list->size++;
+
+        freeList(list);
     }
 
-    fclose(file);
+    outFree(&sink);
+    free(queries.cdf);
+    remove(rosterPath);
+    remove(savedPath);
+
+    fprintf(output, "{\n  \"rows\": %llu,\n  \"rounds\": %d,\n  \"seed\": %llu,\n  \"surnames\": %u,\n", 
+            (unsigned long long)rows, rounds, (unsigned long long)seed, queries.count);
+    fprintf(output, "  \"operations\": [\n");
+    for (int i = 0; i < SERIES_COUNT; i++) 
+    {
+        benchWriteSeries(output, &series[i], i == SERIES_COUNT - 1);
+        free(series[i].seconds);
+    }
+    fprintf(output, "  ]\n}\n");
+    return 1;
 }
 
-void saveListToFile(stud_List *list, const char *filename) 
+#ifdef LIST_METRICS
+// Totals of every instrumented operation since the program started
+static OpMetrics listMetrics[METRIC_OPERATIONS];
+
+static const char *const metricOpNames[METRIC_OPERATIONS] = 
 {
-    FILE *file = fopen(filename, "w");
+    "load", "save", "sort", "search", "add", "delete"
+};
+
+/**
+ * @brief Adds to a metrics counter.
+ * @param counter The counter.
+ * @param value The amount to add.
+ * @return void
+ */
+static void metricsAdd(uint64_t *counter, uint64_t value) 
+{
+#ifdef __GNUC__
+    __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+#else
+    *counter += value;
+#endif
+}
+
+/**
+ * @brief Reads a metrics counter.
+ * @param counter The counter.
+ * @return Its value.
+ */
+static uint64_t metricsLoad(const uint64_t *counter) 
+{
+#ifdef __GNUC__
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+#else
+    return *counter;
+#endif
+}
+
+uint64_t metricsClock(void) 
+{
+#if defined(LIST_POSIX) && defined(CLOCK_MONOTONIC)
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#else
+    return (uint64_t)clock() * (1000000000u / CLOCKS_PER_SEC);
+#endif
+}
+
+void metricsRecord(MetricOp op, uint64_t start, uint64_t records, uint64_t bytes) 
+{
+    uint64_t elapsed = metricsClock() - start;
+    OpMetrics *metrics = &listMetrics[op];
+
+    int bucket = 0;
+    while (bucket < METRICS_BUCKETS && elapsed > (1000ull << bucket)) bucket++;
+
+    metricsAdd(&metrics->buckets[bucket], 1);
+    metricsAdd(&metrics->nanoseconds, elapsed);
+    metricsAdd(&metrics->records, records);
+    metricsAdd(&metrics->bytes, bytes);
+}
 
+int metricsWrite(stud_List *list, const char *path) 
+{
+    char tmpPath[FILENAME_MAX];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+
+    FILE *file = fopen(tmpPath, "w");
     if (!file) 
     {
-        perror("Error opening file for writing");
-        return;
+        perror("Error opening metrics file");
+        return 0;
     }
 
-    stud *current = list->head;
-    while (current != NULL) 
+    OutBuf out;
+    outInit(&out, file);
+
+    outPrintf(&out, "# HELP list_operation_duration_seconds Time taken by list operations.\n");
+    outPrintf(&out, "# TYPE list_operation_duration_seconds histogram\n");
+    for (int op = 0; op < METRIC_OPERATIONS; op++) 
     {
-        fprintf(file, "%s %s %s %d %d\n",
-                current->surname, current->name, current->patronymic, current->age, current->average_score);
-        current = current->next;
+        // Buckets are kept separately and reported cumulatively
+        uint64_t count = 0;
+        for (int bucket = 0; bucket <= METRICS_BUCKETS; bucket++) 
+        {
+            count += metricsLoad(&listMetrics[op].buckets[bucket]);
+            if (bucket < METRICS_BUCKETS) 
+            {
+                outPrintf(&out, "list_operation_duration_seconds_bucket{op=\"%s\",le=\"%.6f\"} %llu\n", 
+                          metricOpNames[op], (double)(1ull << bucket) * 1e-6, (unsigned long long)count);
+            }
+        }
+        outPrintf(&out, "list_operation_duration_seconds_bucket{op=\"%s\",le=\"+Inf\"} %llu\n", metricOpNames[op], (unsigned long long)count);
+        outPrintf(&out, "list_operation_duration_seconds_sum{op=\"%s\"} %.9f\n", 
+                  metricOpNames[op], (double)metricsLoad(&listMetrics[op].nanoseconds) * 1e-9);
+        outPrintf(&out, "list_operation_duration_seconds_count{op=\"%s\"} %llu\n", metricOpNames[op], (unsigned long long)count);
     }
 
-    fclose(file);
-}
+    outPrintf(&out, "# HELP list_records_total Students loaded, saved, sorted, found, added or deleted.\n");
+    outPrintf(&out, "# TYPE list_records_total counter\n");
+    for (int op = 0; op < METRIC_OPERATIONS; op++) 
+    {
+        outPrintf(&out, "list_records_total{op=\"%s\"} %llu\n", metricOpNames[op], (unsigned long long)metricsLoad(&listMetrics[op].records));
+    }
 
-void printStudentsByPerformanceToFile(stud_List *list, const char *filename) 
-{
-    FILE *file = fopen(filename, "w");
-    if (!file) 
+    outPrintf(&out, "# HELP list_bytes_total Bytes read by loads and written by saves.\n");
+    outPrintf(&out, "# TYPE list_bytes_total counter\n");
+    outPrintf(&out, "list_bytes_total{op=\"load\"} %llu\n", (unsigned long long)metricsLoad(&listMetrics[METRIC_LOAD].bytes));
+    outPrintf(&out, "list_bytes_total{op=\"save\"} %llu\n", (unsigned long long)metricsLoad(&listMetrics[METRIC_SAVE].bytes));
+
+    outPrintf(&out, "# HELP list_students Students in the list.\n");
+    outPrintf(&out, "# TYPE list_students gauge\n");
+    outPrintf(&out, "list_students %zu\n", list->size);
+
+    outPrintf(&out, "# HELP list_allocated_bytes Bytes allocated for student records, the surname index and the score index.\n");
+    outPrintf(&out, "# TYPE list_allocated_bytes gauge\n");
+    outPrintf(&out, "list_allocated_bytes{structure=\"records\"} %zu\n", list->pool.bytes);
+    outPrintf(&out, "list_allocated_bytes{structure=\"surname_index\"} %zu\n", list->index.capacity * sizeof(SurnameSlot));
+    outPrintf(&out, "list_allocated_bytes{structure=\"score_index\"} %zu\n", 
+              list->scores.size * sizeof(BstEntry) + list->scores.keys * sizeof(BstNode));
+
+    outFree(&out);
+    if (ferror(file) | fclose(file)) 
     {
-        perror("Error opening file for writing");
-        return;
+        perror("Error writing metrics file");
+        remove(tmpPath);
+        return 0;
     }
+    return replaceFile(tmpPath, path);
+}
 
-    printStudentsByPerformanceHelper(list, file);
+void metricsTick(stud_List *list) 
+{
+    static uint64_t lastWrite = 0;
+    uint64_t now = metricsClock();
 
-    fclose(file);
-}
\ No newline at end of file
+    if (lastWrite == 0 || now - lastWrite >= (uint64_t)LIST_METRICS_INTERVAL * 1000000000u) 
+    {
+        metricsWrite(list, LIST_METRICS_FILE);
+        lastWrite = now;
+    }
+}
+#endif